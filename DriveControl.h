@@ -0,0 +1,137 @@
+// Motor outputs and control-loop timing shared by PushAlgorithm and
+// PullAlgorithm.
+//
+// Both robots drive two wheels through a dual H-bridge: IN1 high and IN2 low
+// turns a wheel forward, both low lets it coast, and the PWM pin sets the
+// duty. MotorOutputs owns those six pins and remembers the last duty written
+// to each wheel for telemetry. Its heading-hold step and in-place turn expect
+// to be stepped every CONTROL_PERIOD_MS, from loops paced by waitNextPeriod;
+// each sketch brings its own gains and heading source.
+//
+// drainTelemetry is the body of both sketches' low-priority TaskTelemetry.
+#ifndef DRIVE_CONTROL_H
+#define DRIVE_CONTROL_H
+
+#include <Arduino.h>
+#include "PidController.h"
+#include "Telemetry.h"
+
+const int CONTROL_PERIOD_MS = 10;
+const float CONTROL_PERIOD_S = CONTROL_PERIOD_MS / 1000.0f;
+const float ROTATE_TOLERANCE_DEG = 2.0f;
+const int ROTATE_TIMEOUT_MS = 3000;    // Give up on a turn that can't finish, e.g. when pinned
+const int TELEMETRY_DRAIN_MS = 50;
+
+// vTaskDelayUntil for loops that sometimes run long, such as a pass that ran a
+// maneuver: after an overrun the schedule restarts from now instead of running
+// the missed periods back to back.
+inline void waitNextPeriod(TickType_t *lastWake, TickType_t period) {
+  TickType_t now = xTaskGetTickCount();
+  if (now - *lastWake >= period) {
+    *lastWake = now;
+  }
+  vTaskDelayUntil(lastWake, period);
+}
+
+class MotorOutputs {
+public:
+  MotorOutputs(int pwmLeft, int leftIn1, int leftIn2, int pwmRight, int rightIn1, int rightIn2)
+    : pwmLeft(pwmLeft), leftIn1(leftIn1), leftIn2(leftIn2),
+      pwmRight(pwmRight), rightIn1(rightIn1), rightIn2(rightIn2) {}
+
+  // analogWrite for the motor PWM pins, remembering the duty for telemetry
+  void writePWM(int pin, int duty) {
+    analogWrite(pin, duty);
+    if (pin == pwmLeft) {
+      leftOut = duty;
+    } else {
+      rightOut = duty;
+    }
+  }
+
+  // One heading-hold step: both wheels at basePwm, down to minPwm less on the
+  // one that turns the robot back. A negative correction means it drifted
+  // counter-clockwise; going backward, the other wheel does the turning.
+  void driveHeld(bool forward, int basePwm, int minPwm, float correction) {
+    int pwmL = basePwm;
+    int pwmR = basePwm;
+    if ((correction < 0) == forward) {
+      pwmR = constrain(basePwm - (int)fabs(correction), minPwm, basePwm);
+    } else {
+      pwmL = constrain(basePwm - (int)fabs(correction), minPwm, basePwm);
+    }
+
+    digitalWrite(leftIn1, forward ? HIGH : LOW);
+    digitalWrite(leftIn2, forward ? LOW : HIGH);
+    writePWM(pwmLeft, pwmL);
+
+    digitalWrite(rightIn1, forward ? HIGH : LOW);
+    digitalWrite(rightIn2, forward ? LOW : HIGH);
+    writePWM(pwmRight, pwmR);
+  }
+
+  // Turns in place by setpoint degrees, counter-clockwise positive, as measured
+  // by heading(). Both wheels run at minPwm plus the controller's output, in
+  // opposite directions, until the turn is within ROTATE_TOLERANCE_DEG.
+  void rotate(float (*heading)(), float setpoint, const PidGains &gains, int minPwm, int maxPwm) {
+    PidController pid(gains, CONTROL_PERIOD_S);
+    float startHeading = heading();
+    TickType_t lastWake = xTaskGetTickCount();
+
+    for (int elapsed = 0; elapsed < ROTATE_TIMEOUT_MS; elapsed += CONTROL_PERIOD_MS) {
+      float angle = heading() - startHeading;
+      if (fabs(setpoint - angle) < ROTATE_TOLERANCE_DEG) {
+        break;
+      }
+      float output = pid.update(setpoint, angle);
+      int pwm = constrain(minPwm + (int)fabs(output), minPwm, maxPwm);
+
+      digitalWrite(leftIn1, output < 0 ? HIGH : LOW);   // Counter-clockwise: left wheel back, right forward
+      digitalWrite(leftIn2, output < 0 ? LOW : HIGH);
+      writePWM(pwmLeft, pwm);
+
+      digitalWrite(rightIn1, output < 0 ? LOW : HIGH);
+      digitalWrite(rightIn2, output < 0 ? HIGH : LOW);
+      writePWM(pwmRight, pwm);
+
+      waitNextPeriod(&lastWake, CONTROL_PERIOD_MS / portTICK_PERIOD_MS);
+    }
+    stop();
+  }
+
+  // Both wheels coast
+  void stop() {
+    digitalWrite(rightIn1, LOW);
+    digitalWrite(rightIn2, LOW);
+    digitalWrite(leftIn1, LOW);
+    digitalWrite(leftIn2, LOW);
+    writePWM(pwmRight, 0);
+    writePWM(pwmLeft, 0);
+  }
+
+  uint8_t leftDuty() const { return leftOut; }
+  uint8_t rightDuty() const { return rightOut; }
+
+private:
+  int pwmLeft, leftIn1, leftIn2;
+  int pwmRight, rightIn1, rightIn2;
+  volatile uint8_t leftOut = 0;
+  volatile uint8_t rightOut = 0;
+};
+
+// Never returns: writes the samples recorded into ring to the serial port as
+// frames, waking every TELEMETRY_DRAIN_MS
+template <size_t CAPACITY>
+void drainTelemetry(TelemetryRing<CAPACITY> &ring) {
+  uint8_t frame[TELEMETRY_FRAME_BYTES];
+  TelemetrySample sample;
+  for (;;) {
+    while (ring.pop(sample)) {
+      telemetryEncode(sample, frame);
+      Serial.write(frame, sizeof(frame));
+    }
+    vTaskDelay(TELEMETRY_DRAIN_MS / portTICK_PERIOD_MS);
+  }
+}
+
+#endif
@@ -2,14 +2,72 @@
 #include <stdlib.h>
 #define HAVE_STRUCT_TIMESPEC
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 // Constants for game configuration
-#define NUM_CARDS 52
-#define MAX_PLAYERS 10
-#define HAND_SIZE 2
+#define NUM_CARDS 52                 // Cards in one deck; larger tables play from a shoe of several decks
+#define MAX_PLAYERS 10               // Most players in the thread-per-player game; batch and table modes have no cap
+#define HAND_SIZE 2                  // Hand size of the threaded game and of the classic rules
+#define MAX_HAND_SIZE 4              // Largest hand a rule variant may use
+
+// Define LOCK_FREE_DECK to draw and discard through the lock-free deck instead of the mutex-guarded ring
+// Define RNG_SPLITMIX to use the counter-based SplitMix64 generator instead of xoshiro256**
+// Define LOCK_STATS to count lock acquisitions, contention, hold and wait times and turn latency;
+// without it the tracked lock macros are plain pthread calls and no timing code is compiled in
+
+#define LOCK_HIST_BUCKETS 32         // log2 nanosecond buckets, the last one also holds anything slower
+
+// Constants for the asynchronous log
+#define LOG_RECORD_SIZE 256          // Bytes per log slot; longer records span consecutive slots
+#define LOG_RING_CAPACITY 4096       // Records buffered between the players and the writer (power of two)
+#define LOG_BATCH_BYTES (1 << 16)    // Largest single write issued by the writer thread
+#define LOG_IDLE_SLEEP_NS 200000     // Writer back-off when the ring is empty
+
+// Discard policies of the rule variants
+enum {
+    DISCARD_RANDOM,          // A random card, drawn from the player's stream (the classic rules)
+    DISCARD_OLDEST,          // The card held longest
+    DISCARD_HIGHEST          // The highest-valued card
+};
+
+// Rule variants of the fast engine: name, hand size, decks per shoe (0 sizes
+// the shoe to the table) and discard policy. Each entry gets its own engine,
+// compiled with the rules as constants so the hand loops unroll.
+#define RULE_VARIANTS(X) \
+    X(classic,         HAND_SIZE, 0, DISCARD_RANDOM) \
+    X(classic_oldest,  HAND_SIZE, 0, DISCARD_OLDEST) \
+    X(three_card,      3,         0, DISCARD_RANDOM) \
+    X(three_card_high, 3,         0, DISCARD_HIGHEST) \
+    X(four_card,       4,         0, DISCARD_RANDOM) \
+    X(single_deck,     HAND_SIZE, 1, DISCARD_RANDOM) \
+    X(six_deck,        HAND_SIZE, 6, DISCARD_RANDOM)
+
+#if defined(__GNUC__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+// Constants for the table scheduler
+#define SCHED_TURN_SLICE 64          // Turns a worker plays at one table before handing it back to the run queue, rounded up to a whole round
 
 // Structure for a playing card
 typedef struct {
@@ -17,20 +75,206 @@ typedef struct {
     char suit;
 } Card;
 
+// One-byte card: value (1-13) in bits 0-3, suit index (H, D, C, S) in bits 4-5.
+// Real cards never pack to 0, so 0 marks an empty slot.
+typedef uint8_t PackedCard;
+#define CARD_VALUE(packed) ((packed) & 0x0F)
+
+// Random stream. Every game and every player owns one, all derived from the
+// game seed, so results never depend on how the threads interleave.
+typedef struct {
+    uint64_t s[4];           // xoshiro256** state; SplitMix64 only uses s[0] as its counter
+} Rng;
+
+#ifdef LOCK_STATS
+// Counters for one lock, or for the log ring's slot waits. Updated with relaxed
+// atomics so the same struct can also be shared by threads that hold no lock.
+typedef struct {
+    _Atomic long long acquisitions;
+    _Atomic long long contended;     // Acquisitions that had to wait
+    _Atomic long long waitNs;
+    _Atomic long long waitMaxNs;
+    _Atomic long long holdNs;
+    _Atomic long long holdMaxNs;
+    _Atomic long long waitHist[LOCK_HIST_BUCKETS];
+    _Atomic long long holdHist[LOCK_HIST_BUCKETS];
+    long long heldSince;             // Written only by the current holder
+} LockStats;
+
+// Tracked locks time the wait when the lock is busy and the time it is held
+#define lockTracked(mutex, stats) trackedLock((mutex), (stats))
+#define unlockTracked(mutex, stats) trackedUnlock((mutex), (stats))
+#define condWaitTracked(cond, mutex, stats) trackedCondWait((cond), (mutex), (stats))
+#else
+#define lockTracked(mutex, stats) pthread_mutex_lock(mutex)
+#define unlockTracked(mutex, stats) pthread_mutex_unlock(mutex)
+#define condWaitTracked(cond, mutex, stats) pthread_cond_wait((cond), (mutex))
+#endif
+
+// Fixed-capacity ring of cards. The card i places above the bottom lives at
+// cards[(bottom + i) & mask], so drawing from the top and putting a card
+// back at the bottom are both O(1). The capacity is a power of two sized
+// for the game's shoe.
+typedef struct {
+    PackedCard *cards;
+    int mask;
+    int bottom;
+    int size;
+} CardRing;
+
+// Lock-free variant of the ring. Slots hold one-byte packed cards with 0
+// marking an empty slot; state packs the bottom index (bits 0-23), the size (bits 24-47)
+// and a version counter (bits 48-63) that guards the CAS against ABA.
+typedef struct {
+    _Atomic PackedCard *slots;
+    uint32_t mask;
+    _Atomic uint64_t state;
+} LockFreeDeck;
+
+#ifdef LOCK_FREE_DECK
+typedef LockFreeDeck Deck;
+#else
+typedef CardRing Deck;
+#endif
+
+struct GameState;
+struct FastGame;
+struct RuleVariant;
+
+// One record slot in the log ring. The sequence number tells producers and the
+// writer who owns the slot: pos means free for the producer that claimed pos,
+// pos + 1 means filled and ready to be written.
+typedef struct {
+    atomic_size_t sequence;
+    int length;
+    char text[LOG_RECORD_SIZE];
+} LogSlot;
+
+// Bounded multi-producer, single-consumer log ring drained by a writer thread
+typedef struct {
+    LogSlot *slots;
+    _Alignas(64) atomic_size_t enqueuePos; // Next position to claim; claim order is the log order
+    _Alignas(64) size_t dequeuePos;        // Next position the writer expects, writer thread only
+    atomic_bool stopping;
+    FILE *file;
+    char *batch;                           // Records collected for the next write
+    size_t batchLength;
+    int flushIntervalMs;                   // 0 writes as soon as the ring runs dry, otherwise hold records up to this long
+    pthread_t writer;
+    long long recordsWritten;
+    long long batchesWritten;
+#ifdef LOCK_STATS
+    LockStats slotStats;                   // Producers waiting for the writer to free a slot
+#endif
+} AsyncLog;
+
+// Event types of the binary game stream. Each record stands for one or more
+// lines of the text log; the rest of each line is rebuilt from replayed state.
+enum {
+    EVENT_GAME_START = 1,    // player: number of players, value: chips per bag
+    EVENT_ROUND_START,       // player: dealer, value: round
+    EVENT_SHOE,              // Shuffled shoe, bottom first, five cards per record (card plus four in value)
+    EVENT_GREASY,            // player: dealer, card: the greasy card
+    EVENT_DEAL,              // player, card: the card dealt at the start of the round
+    EVENT_DRAW,              // player, card: the card drawn at the start of a turn
+    EVENT_HOLDS_GREASY,      // player: holds a card matching the greasy card
+    EVENT_DISCARD,           // player, card, value: the hand index it was taken from
+    EVENT_BAG_OPENED,        // value: chips in the new bag
+    EVENT_CHIPS_EATEN,       // player, value: chips eaten
+    EVENT_ROUND_WON,         // player: winner, value: round; every other player lost it
+    EVENT_ROUND_END,         // player: dealer
+    EVENT_GAME_END,          // value: rounds played
+    EVENT_MAGIC = 0xEC       // First record of a stream: card is the format version, value is EVENT_MAGIC_VALUE
+};
+#define EVENT_FORMAT_VERSION 1
+#define EVENT_MAGIC_VALUE 0x56454347u // "GCEV" read as little-endian bytes
+#define EVENT_SHOE_CARDS 5
+#define EVENT_MAX_PLAYERS UINT16_MAX
+
+// Constants for batch checkpoints
+#define SNAPSHOT_MAGIC 0x50434347u    // "GCCP" read as little-endian bytes
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_ALIGN 64             // Worker records start on their own cache line
+#define SNAPSHOT_NAME_BYTES 32        // Rule variant name, NUL included
+#define SNAPSHOT_PATH_BYTES 1024      // Output paths as given on the command line, NUL included
+#define SNAPSHOT_HEADER_BYTES ((sizeof(SnapshotHeader) + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN)
+
+// Columns of the per-round result file, in the order they follow each other inside a chunk.
+// Widest first, so every column starts aligned to its own width.
+enum {
+    RESULT_GAME,             // uint64: game index within the batch
+    RESULT_ROUND,            // uint32: round, from 1
+    RESULT_DEALER,           // uint32: dealer's seat, from 1
+    RESULT_WINNER,           // uint32: winner's seat, from 1
+    RESULT_TURNS,            // uint32: turns taken in the round
+    RESULT_CHIPS_EATEN,      // uint32: chips eaten in the round
+    RESULT_BAGS_USED,        // uint32: bags opened in the round; round 1 counts the game's first bag
+    RESULT_GREASY,           // uint8: value of the greasy card
+    RESULT_COLUMNS
+};
+#define RESULT_MAGIC 0x53524347u        // "GCRS": file header and trailer
+#define RESULT_CHUNK_MAGIC 0x43524347u  // "GCRC": start of every chunk
+#define RESULT_FORMAT_VERSION 1
+#define RESULT_CHUNK_ROWS 4096          // Rows a writer buffers before appending them as one chunk
+
+// One fixed-size record of the binary event stream
+typedef struct {
+    uint8_t type;
+    PackedCard card;
+    uint16_t player;
+    uint32_t value;
+} GameEvent;
+_Static_assert(sizeof(GameEvent) == 8, "event records are written as raw 8-byte structs");
+
+// Destination shared by every game writing events. Games buffer their own
+// events and append them in one piece when they end, so games played by
+// different threads never interleave in the file.
+typedef struct {
+    FILE *file;
+    pthread_mutex_t mutex;
+    long long eventsWritten;
+    long long gamesWritten;
+    uint64_t fileBytes;      // Length of the stream, the format record included
+} EventSink;
+
+// Events a checkpointing batch worker holds back until its next checkpoint
+typedef struct {
+    GameEvent *events;
+    size_t count;
+    size_t capacity;
+    long long games;
+} EventBuffer;
+
 // Structure for a player
 typedef struct {
     int id;
-    Card hand[HAND_SIZE];
     pthread_t thread;
-    int hand_size;
+    int roundsWon;           // Rounds this seat has won in the current game
+    struct GameState *game;  // Game this player is seated at
+    pthread_mutex_t turn_mutex; // Guards this player's turn token
+    pthread_cond_t turn_cond;   // Signaled only when this player is handed the turn
+    bool hasTurn;            // Turn token, handed on by the previous player
+    Rng rng;                 // The player's own stream for discards and chip eating
+    bool roundOver;          // Set by the winner so this player stops waiting
+#ifdef LOCK_STATS
+    LockStats turnLockStats; // This player's turn_mutex
+    long long spuriousWakeups; // Wake-ups with neither the token nor the round over
+    long long turnsTaken;
+    long long turnLatencyNs; // Total time from the token being handed over to this thread running
+    long long turnLatencyMaxNs;
+    long long signaledAt;    // When the token was handed over, guarded by turn_mutex
+#endif
 } Player;
 
 // Main game state structure
-typedef struct {
-    Card deck[NUM_CARDS];
-    Card discarded[NUM_CARDS];
-    int numDiscarded;
-    int deck_size;
+typedef struct GameState {
+    Deck deck;               // Draws come off the top, discards go back in at the bottom
+    int numDecks;            // Decks in the shoe, enough that every player can hold a full hand
+    int shoeSize;            // numDecks * NUM_CARDS
+    Card *shoe;              // Scratch space for building and shuffling the shoe each round
+    char *deckLine;          // Scratch space for the DECK log line
+    PackedCard *handSlots[HAND_SIZE]; // Hands stored by column: handSlots[s][seat] is card s of that seat, 0 when empty
+    uint8_t *handSizes;      // Cards in each seat's hand
     Card greasyCard;
     int currentPlayer;
     int dealerId;
@@ -38,507 +282,4317 @@ typedef struct {
     int round;
     int totalRounds;
     pthread_mutex_t deck_mutex;
-    pthread_mutex_t turn_mutex;
-    pthread_cond_t turn_cond;
-    FILE *log_file;
-    pthread_mutex_t log_mutex;
+    AsyncLog *log;           // NULL when the game runs without a log (batch mode)
     pthread_mutex_t chip_mutex;
+    pthread_barrier_t round_barrier; // Dealer plus every player thread meet here before and after each round
+    bool gameOver;           // Tells the persistent player threads to exit at the next round barrier
+    Rng rng;                 // Game stream, used by the dealer to shuffle
+    uint64_t seed;           // Seed every stream of this game is derived from
+    EventSink *events;       // NULL unless the game records a binary event stream
+    GameEvent *eventBuffer;  // This game's events, appended to the sink when the game ends
+    size_t eventCount;
+    size_t eventCapacity;
+#ifdef LOCK_STATS
+    LockStats deckLockStats;
+    LockStats chipLockStats;
+#endif
     int numPlayers;
     int numChips;
     int chips_in_bag;
+    int chips_eaten;
     int total_bags_used;
     Player players[];
 } GameState;
 
-// Global game state variable
-GameState game;
-Player players[MAX_PLAYERS];
+// Aggregate results of a batch of games
+typedef struct {
+    long long games;
+    long long rounds;
+    long long chipsEaten;
+    long long bagsOpened;
+    long long turns;
+    long long *seatWins;     // Rounds won per seat, numPlayers entries
+} BatchTotals;
+
+// One entry of the rule registry, generated from RULE_VARIANTS
+typedef struct RuleVariant {
+    const char *name;
+    int handSize;
+    int decksPerShoe;        // 0 when the shoe grows with the table
+    int discardPolicy;
+    void (*play)(struct FastGame *fast, uint64_t seed);
+    void (*playRound)(struct FastGame *fast); // The next round of a game fastStartGame began
+} RuleVariant;
+
+// Outcome of one round of a fast-engine game
+typedef struct {
+    uint32_t dealer;
+    uint32_t winner;
+    uint32_t turns;
+    uint32_t chipsEaten;
+    uint32_t bagsUsed;
+    uint8_t greasyValue;
+} RoundResult;
+
+// Single-threaded engine for statistics. It plays the same rules with the same
+// random streams as the threaded game, but one table runs start to finish on
+// one thread, so there are no locks, no log and no allocation once set up.
+typedef struct FastGame {
+    int numPlayers;
+    int numChips;
+    int shoeSize;
+    PackedCard *freshShoe;   // Unshuffled shoe, copied in at the start of every round
+    PackedCard *deck;        // Ring of cards, deckMask + 1 slots
+    int deckMask;
+    int deckBottom;
+    int deckSize;
+    const struct RuleVariant *rules;
+    PackedCard *handSlots[MAX_HAND_SIZE]; // Same column layout as GameState, 0 when empty; rules->handSize in use
+    uint8_t *handSizes;
+    uint8_t *greasyValues;   // The round's greasy value once per seat, for matchGreasyHands
+    uint8_t *greasyMatches;  // Seats whose hand matches it, filled a lap at a time
+    Rng rng;                 // Game stream, stream 0
+    Rng *playerRngs;         // Player i uses stream i + 1
+    int *roundsWon;
+    RoundResult *roundResults; // One per round of the last game played
+    int rounds;
+    long long turns;
+    int chipsEaten;
+    int bagsUsed;
+    int bagsBefore;          // Bags used before the current round
+    int chipsInBag;
+    int currentPlayer;
+    int dealerId;
+    bool recordEvents;       // Keep the game's events, the same records the threaded game emits
+    GameEvent *events;
+    size_t eventCount;
+    size_t eventCapacity;
+} FastGame;
+
+// Header of a batch snapshot file. The file is mapped shared, so whatever the
+// workers have published survives the process being killed.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seed;
+    int64_t numGames;
+    int32_t numPlayers;
+    int32_t numChips;
+    int32_t numWorkers;
+    int32_t checkpointMs;    // Interval between a worker's checkpoints
+    _Atomic int32_t complete; // Set once every worker has published its last game
+    char rules[SNAPSHOT_NAME_BYTES];       // Rule variant the batch plays
+    char eventsPath[SNAPSHOT_PATH_BYTES];  // Event stream the batch appends to, empty for none
+    char resultsPath[SNAPSHOT_PATH_BYTES]; // Per-round result file, empty for none
+} SnapshotHeader;
+
+// One checkpoint of a worker: the next game it will play and its totals so far.
+// Games are replayed from their seed, so the game index is the whole in-flight state.
+// The output lengths are those of the files when the checkpoint was published; a
+// resumed batch cuts its outputs back to the longest of them.
+typedef struct {
+    int64_t nextGame;
+    int64_t eventsBytes;
+    int64_t resultsBytes;
+    int64_t games;
+    int64_t rounds;
+    int64_t chipsEaten;
+    int64_t bagsOpened;
+    int64_t turns;
+    int64_t seatWins[];
+} WorkerCheckpoint;
+
+// Mapped snapshot file. Every worker record holds a publish counter followed by
+// two checkpoint copies; a worker writes the copy the counter does not point at
+// and then bumps the counter, so a torn write never replaces a good checkpoint.
+typedef struct {
+    unsigned char *base;
+    size_t size;
+    size_t copySize;         // Bytes per WorkerCheckpoint, seat wins included
+    size_t recordStride;     // Bytes per worker record, a multiple of SNAPSHOT_ALIGN
+    SnapshotHeader *header;
+} Snapshot;
+
+// On-disk pieces of the per-round result file. The file is a header, then
+// chunks appended in any order, then the footer index and a fixed-size trailer:
+//   ResultFileHeader | chunk ... | ResultChunkEntry[chunkCount] | ResultTrailer
+// A chunk of n rows is a ResultChunkHeader followed by each column's n values,
+// so a reader can map the file and walk one column without touching the rest.
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t columns;
+} ResultFileHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t rows;
+} ResultChunkHeader;
+
+typedef struct {
+    uint64_t offset;         // File offset of the chunk header
+    uint64_t rows;
+} ResultChunkEntry;
+
+typedef struct {
+    uint64_t footerOffset;   // File offset of the first ResultChunkEntry
+    uint64_t chunkCount;
+    uint64_t rows;
+    uint32_t columns;
+    uint32_t magic;
+} ResultTrailer;
+
+// Rows buffered by one thread. The buffer is a full chunk in its on-disk
+// layout, so appending it is a single write.
+typedef struct {
+    unsigned char *chunk;
+    size_t rows;
+    ResultChunkEntry *chunks; // Chunks this writer has appended, for the footer
+    size_t chunkCount;
+    size_t chunkCapacity;
+    unsigned char *held;     // Finished chunks not yet appended, back to back (checkpointed batches)
+    size_t heldBytes;
+    size_t heldCapacity;
+} ResultWriter;
+
+// Result file shared by the batch workers. Each worker owns one writer; a
+// chunk claims its place in the file with one atomic add, so writers never
+// wait for each other.
+typedef struct {
+    int fd;
+    _Atomic uint64_t fileEnd;  // Next free byte
+    bool holdChunks;           // Writers keep finished chunks until commitResultChunks
+    int numWriters;
+    ResultWriter *writers;
+    long long rowsWritten;     // Filled in when the sink is closed
+    long long chunksWritten;
+} ResultSink;
+
+// Configuration shared by every batch worker
+typedef struct {
+    uint64_t seed;
+    int numPlayers;
+    int numChips;
+    long long numGames;
+    int numWorkers;
+    pthread_mutex_t totals_mutex;
+    BatchTotals totals;
+    EventSink *events;       // Shared event stream, NULL when the batch records none
+    Snapshot *snapshot;      // Checkpoint file, NULL when the batch keeps none
+    pthread_mutex_t commit_mutex; // Orders checkpoints with the output they cover
+    ResultSink *results;     // Per-round result file, NULL when the batch writes none
+    const RuleVariant *rules;
+} BatchConfig;
+
+// Per-worker argument for the batch runner
+typedef struct {
+    BatchConfig *config;
+    int workerId;
+    pthread_t thread;
+} BatchWorker;
+
+// One table in the M:N scheduler: only what its game carries from one round to the
+// next. Deck and hands last a single round, so they live in the fast engine of the
+// worker playing it; between slices a table holds no cards, locks or threads.
+typedef struct {
+    uint64_t seed;
+    bool started;            // fastStartGame has run for this table
+    Rng rng;                 // Game stream
+    Rng *playerRngs;         // One stream per seat
+    int *roundsWon;
+    int rounds;
+    long long turns;         // Turns played at this table
+    int chipsEaten;
+    int bagsUsed;
+    int bagsBefore;
+    int chipsInBag;
+    int currentPlayer;
+    int dealerId;
+} Table;
+
+// Run queue shared by the table workers. Any worker can pick up any table,
+// so the number of threads tracks the cores rather than the players.
+typedef struct {
+    Table **queue;           // Ring of runnable tables, capacity numTables
+    int numTables;
+    int head;
+    int count;
+    int activeTables;        // Tables whose game has not finished yet
+    pthread_mutex_t queue_mutex;
+    pthread_cond_t queue_cond;
+    int numPlayers;
+    int numChips;
+    pthread_mutex_t totals_mutex;
+    BatchTotals totals;
+} TableScheduler;
+
+// The original array deck, kept as the reference for the deck benchmark
+typedef struct {
+    Card cards[NUM_CARDS];
+    int size;
+    pthread_mutex_t mutex;
+} ArrayDeck;
+
+// Shared state for the deck benchmark; variant selects which deck the threads hammer
+typedef struct {
+    int variant;             // 0 array + mutex, 1 ring + mutex, 2 lock-free ring
+    long long opsPerThread;
+    ArrayDeck array;
+    CardRing ring;
+    pthread_mutex_t ringMutex;
+    LockFreeDeck lockFree;
+} DeckBench;
+
+// The hand layout before hands moved into GameState columns, kept as the
+// reference for the hand-check benchmark
+typedef struct {
+    Card hand[HAND_SIZE];
+    int hand_size;
+} LegacyHand;
+
+// Constants for the benchmark suite
+#define BENCH_MAX_RESULTS 32
+#define BENCH_REPEATS 5              // Each microbenchmark keeps the best of this many runs
+#define BENCH_DEFAULT_THRESHOLD 10.0 // Percent change against the baseline that counts as a regression
+
+// One measurement of the benchmark suite. Microbenchmarks report ns per
+// operation (lower is better), macro benchmarks report games per second.
+typedef struct {
+    char name[48];
+    const char *unit;
+    double value;
+    long long iterations;
+    bool higherIsBetter;
+} BenchResult;
 
 // Function Prototypes
-void shuffleDeck(Card deck[]);
+void shuffleDeck(Card deck[], int count, Rng *rng);
+uint64_t splitMix64(uint64_t *state);
+void rngSeed(Rng *rng, uint64_t seed, uint64_t stream);
+uint64_t rngNext(Rng *rng);
+uint32_t rngBelow(Rng *rng, uint32_t bound);
 void openNewBag(GameState *game);
 Card drawCard(GameState *game);
-void* playerRoutine(void *arg);
 void dealCards(GameState *game);
-void initializeGame(GameState *game, int numPlayers, int numChips);
+GameState* allocateGame(int numPlayers);
+void initializeGame(GameState *game, int numPlayers, int numChips, uint64_t seed, const char *logPath, int logFlushMs);
+void resetGame(GameState *game, uint64_t seed);
 void initializeDeck(Card deck[]);
+void initializeShoe(Card cards[], int numDecks);
+int shoeDecksFor(int numPlayers, int handSize);
+int ringCapacityFor(int count);
+bool ringInit(CardRing *ring, int capacity);
+void ringFree(CardRing *ring);
+void ringLoad(CardRing *ring, const Card cards[], int count);
+bool ringDraw(CardRing *ring, Card *card);
+bool ringDiscard(CardRing *ring, Card card);
+PackedCard packCardByte(Card card);
+Card unpackCardByte(PackedCard packed);
+Card handCard(GameState *game, int seat, int slot);
+void handAdd(GameState *game, int seat, Card card);
+Card handRemove(GameState *game, int seat, int slot);
+void handClear(GameState *game, int seat);
+bool handHasValue(GameState *game, int seat, int value);
+size_t matchGreasyHands(PackedCard *const slots[], int handSize, const uint8_t greasyValues[], uint8_t matches[], size_t count);
+bool lockFreeInit(LockFreeDeck *deck, int capacity);
+void lockFreeFree(LockFreeDeck *deck);
+void lockFreeLoad(LockFreeDeck *deck, const Card cards[], int count);
+bool lockFreeDraw(LockFreeDeck *deck, Card *card);
+bool lockFreeDiscard(LockFreeDeck *deck, Card card);
+bool allocateDeck(GameState *game);
+void freeDeck(GameState *game);
+void loadDeck(GameState *game, const Card cards[], int count);
+int deckSize(GameState *game);
+Card deckCardAt(GameState *game, int index);
 void cleanup(GameState *game);
-void logAction(const char* action);
-void cleanup(GameState *game);
+void logAction(GameState *game, const char* action);
+void logActionf(GameState *game, const char* format, ...);
+AsyncLog* openLog(const char *path, int flushIntervalMs);
+void closeLog(AsyncLog *log);
+size_t claimLogPositions(AsyncLog *log, size_t count);
+LogSlot* waitForLogSlot(AsyncLog *log, size_t pos);
+void commitLogSlot(LogSlot *slot, size_t pos);
+#ifdef LOCK_STATS
+long long statsNowNs(void);
+void statsRecord(_Atomic long long hist[], _Atomic long long *total, _Atomic long long *max, long long ns);
+void trackedLock(pthread_mutex_t *mutex, LockStats *stats);
+void trackedUnlock(pthread_mutex_t *mutex, LockStats *stats);
+void trackedCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex, LockStats *stats);
+void mergeLockStats(LockStats *into, const LockStats *from);
+void printLockStats(const char *name, const LockStats *stats);
+void reportLockStats(GameState *game);
+#endif
+void* logWriterRoutine(void *arg);
 void* playerRoutine(void* arg);
-void waitForTurn(GameState *game, int playerId);
-void signalNextPlayerTurn(GameState* game, int nextPlayerId);
+bool playTurn(GameState *game, Player *player);
+bool fastGameInit(FastGame *fast, int numPlayers, int numChips, const RuleVariant *rules, bool recordEvents);
+void fastGameFree(FastGame *fast);
+void fastEmit(FastGame *fast, int type, int player, PackedCard card, uint32_t value);
+PackedCard fastDraw(FastGame *fast);
+void fastPlayGame(FastGame *fast, uint64_t seed);
+void fastStartGame(FastGame *fast, uint64_t seed);
+static ALWAYS_INLINE void fastPlayRound(FastGame *fast, const int handSize, const int discardPolicy);
+static ALWAYS_INLINE void fastPlayRules(FastGame *fast, uint64_t seed, const int handSize, const int discardPolicy);
+#define DECLARE_RULE_ENGINE(name, hand, decks, discard) \
+    void fastPlay_##name(FastGame *fast, uint64_t seed); \
+    void fastPlayRound_##name(FastGame *fast);
+RULE_VARIANTS(DECLARE_RULE_ENGINE)
+const RuleVariant* findRuleVariant(const char *name);
+int shoeDecksForRules(const RuleVariant *rules, int numPlayers);
+int runSweep(uint64_t seed, int numPlayers, int numChips, long long numGames, int numWorkers,
+             const char *names[], int numNames);
+void appendEvents(EventSink *sink, const GameEvent events[], size_t count, long long games);
+int runConformance(uint64_t seed, int numPlayers, int numChips, long long numGames);
+void playThreadedGame(GameState *game);
+void startPlayerThreads(GameState *game);
+void stopPlayerThreads(GameState *game);
+bool waitForTurn(GameState *game, int playerId);
+void signalNextPlayerTurn(GameState* game, int nextPlayerId, bool roundOver);
 void declareWinner(GameState *game, Player* player);
 void declareLosers(GameState* game, int winnerId);
 void endRound(GameState *game);
 void startRound(GameState *game);
+void resetTurns(GameState *game);
 void discardCard(GameState *game, Player* player, Card card);
 void eatChips(GameState *game, Player *player);
 void logDeckContents(GameState* game);
-void displayPlayerHand(FILE *log_file, Player *player);
+void displayPlayerHand(GameState *game, Player *player);
 const char* cardValueStr(int value);
+uint64_t gameSeed(uint64_t seed, long long gameIndex);
+void* batchWorker(void *arg);
+int runBatch(uint64_t seed, int numPlayers, int numChips, long long numGames, int numWorkers,
+             const RuleVariant *rules, const char *eventsPath, const char *resultsPath, Snapshot *snapshot);
+size_t resultColumnWidth(int column);
+size_t resultColumnOffset(int column, size_t rows);
+ResultSink* openResultSink(const char *path, int numWriters);
+ResultSink* reopenResultSink(const char *path, int numWriters, uint64_t committedBytes);
+ResultSink* newResultSink(int fd, int numWriters);
+void freeResultSink(ResultSink *sink);
+bool commitResultChunks(ResultSink *sink, ResultWriter *writer);
+bool addResultChunk(ResultWriter *writer, uint64_t offset, uint64_t rows);
+size_t resultChunkBytes(size_t rows);
+bool closeResultSink(ResultSink *sink);
+void appendRoundResults(ResultSink *sink, int writerId, long long gameId, const RoundResult rounds[], int count);
+bool flushResultChunk(ResultSink *sink, ResultWriter *writer);
+bool writeAllAt(int fd, const void *data, size_t size, uint64_t offset);
+int compareChunkEntries(const void *a, const void *b);
+int runResults(const char *path);
+Snapshot* createSnapshot(const char *path, uint64_t seed, int numPlayers, int numChips, long long numGames,
+                         int numWorkers, int checkpointMs, const RuleVariant *rules,
+                         const char *eventsPath, const char *resultsPath);
+Snapshot* openSnapshot(const char *path);
+void closeSnapshot(Snapshot *snapshot);
+Snapshot* mapSnapshot(int fd, size_t size, int numPlayers, int numWorkers);
+size_t snapshotSize(int numPlayers, int numWorkers, size_t *copySize, size_t *recordStride);
+unsigned char* snapshotRecord(Snapshot *snapshot, int workerId);
+long long loadCheckpoint(Snapshot *snapshot, int workerId, BatchTotals *totals);
+void saveCheckpoint(Snapshot *snapshot, int workerId, long long nextGame, const BatchTotals *totals,
+                    uint64_t eventsBytes, uint64_t resultsBytes);
+void committedOutput(Snapshot *snapshot, uint64_t *eventsBytes, uint64_t *resultsBytes);
+void commitCheckpoint(BatchConfig *config, int workerId, long long nextGame, const BatchTotals *totals, EventBuffer *held);
+int runResume(const char *path);
+int runSingleGame(uint64_t seed, int numPlayers, int numChips, int logFlushMs, const char *eventsPath);
+void emitEvent(GameState *game, int type, int player, uint8_t card, uint32_t value);
+void emitShoe(GameState *game);
+void flushGameEvents(GameState *game);
+EventSink* openEventSink(const char *path);
+EventSink* reopenEventSink(const char *path, uint64_t committedBytes);
+void closeEventSink(EventSink *sink);
+int runReplay(const char *path, bool renderText);
+void replayError(long long *errors, long long index, const char *message, int player);
+bool eventHasSeat(int type);
+void renderHand(FILE *out, int playerId, const Card hand[], int handSize);
+void renderDeck(FILE *out, CardRing *deck);
+double benchNow(void);
+double timeHandoffs(int numPlayers, long long numTurns);
+double benchShuffle(long long iterations);
+double benchDraw(long long iterations);
+double benchDiscard(long long iterations);
+double benchEatChips(long long iterations);
+double benchLogAction(long long iterations);
+double benchLogDeckContents(long long iterations);
+double benchThreadedGames(int numPlayers, int numGames, bool withLog);
+double benchHandCheck(bool packed, size_t numHands, long long passes, size_t *found);
+double benchHandCheckLoop(long long iterations);
+double benchHandCheckPacked(long long iterations);
+int runHandBenchmark(size_t numHands, long long passes);
+void addBenchResult(BenchResult results[], int *count, const char *name, const char *unit,
+                    double value, long long iterations, bool higherIsBetter);
+bool writeBenchJson(const char *path, const BenchResult results[], int count);
+int compareBenchBaseline(const char *path, const BenchResult results[], int count, double thresholdPct);
+int runBenchSuite(const char *outPath, const char *baselinePath, double thresholdPct);
+void printBatchTotals(const BatchTotals *totals, int numPlayers);
+void pushTable(TableScheduler *sched, Table *table);
+Table* popTable(TableScheduler *sched);
+bool runTableSlice(FastGame *fast, Table *table);
+void tableDone(TableScheduler *sched, Table *table);
+void* tableWorker(void *arg);
+int runTables(uint64_t seed, int numTables, int numPlayers, int numChips, int numWorkers);
+void* handoffRoutine(void *arg);
+void* deckBenchRoutine(void *arg);
+int runDeckBenchmark(int numThreads, long long opsPerThread);
+int runHandoffBenchmark(int numPlayers, long long numTurns);
+double elapsedSeconds(const struct timespec *start);
 
-void displayPlayerHand(FILE *log_file, Player *player) {
-    fprintf(log_file, "PLAYER %d: hand ", player->id);
-    if (player->hand_size > 0) {
-        for (int i = 0; i < player->hand_size; i++) {
-            // Print each card in the player's hand
-            fprintf(log_file, "%s", cardValueStr(player->hand[i].value));
-            // Print a comma after each card except the last
-            if (i < player->hand_size - 1) {
-                fprintf(log_file, ",");
-            }
-        }
+void displayPlayerHand(GameState *game, Player *player) {
+    // Nothing to build when the game runs without a log
+    if (!game->log) {
+        return;
+    }
+
+    char log_message[128];
+    int seat = player->id - 1;
+    int handSize = game->handSizes[seat];
+    int len = sprintf(log_message, "PLAYER %d: hand ", player->id);
+    for (int i = 0; i < handSize; i++) {
+        // Append each card in the player's hand, with a comma after each card except the last
+        len += sprintf(log_message + len, "%s%s", cardValueStr(CARD_VALUE(game->handSlots[i][seat])),
+                       (i < handSize - 1) ? "," : "");
     }
-    // Move to the next line after printing the hand
-    fprintf(log_file, "\n");
+    logAction(game, log_message);
 }
 void logDeckContents(GameState* game) {
-    char log_message[1024] = "DECK: "; // Start the log message with "DECK: "
+    // Building the deck string is expensive, skip it entirely when nothing is logged
+    if (!game->log) {
+        return;
+    }
+
+    // The line is built in the game's scratch buffer, sized for a full shoe
+    char *log_message = game->deckLine;
+    strcpy(log_message, "DECK: "); // Start the log message with "DECK: "
+    int len = 6;
 
-    for (int i = 0; i < game->deck_size; ++i) {
-        char cardStr[5]; // Buffer to hold the string representation of each card
-        // Convert the card value to a string representation (A, J, Q, K, or number)
-        const char* cardValueString = cardValueStr(game->deck[i].value);
-        sprintf(cardStr, "%s ", cardValueString); // Format the card string
-        strcat(log_message, cardStr); // Append the card string to the log message
+    int size = deckSize(game);
+    for (int i = 0; i < size; ++i) {
+        // Append the string representation of each card (A, J, Q, K, or number), bottom first
+        len += sprintf(log_message + len, "%s ", cardValueStr(deckCardAt(game, i).value));
     }
 
-    logAction(log_message); // Log the deck contents
+    logAction(game, log_message); // Log the deck contents
 }
 
 const char* cardValueStr(int value) {
-    static char numStr[3]; // Static buffer to hold string representation of the number
+    // Constant table so concurrent games never share a formatting buffer
+    static const char* const names[] = {
+        "?", "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K"
+    };
 
-    switch (value) {
-        case 1: return "A"; // Return "A" for Ace
-        case 11: return "J"; // Return "J" for Jack
-        case 12: return "Q"; // Return "Q" for Queen
-        case 13: return "K"; // Return "K" for King
-        default:
-            sprintf(numStr, "%d", value); // Convert numeric value to string for other cards
-            return numStr;
+    if (value < 1 || value > 13) {
+        return names[0];
     }
+    return names[value];
 }
 
-void signalNextPlayerTurn(GameState* game, int nextPlayerId) {
-    pthread_mutex_lock(&game->turn_mutex); // Lock the turn mutex to ensure thread-safe access
-
-    // Set the current player to the next player's ID
+void signalNextPlayerTurn(GameState* game, int nextPlayerId, bool roundOver) {
+    // Only the token holder writes the current player, so no lock is needed here
     game->currentPlayer = nextPlayerId;
 
-    // Signal to all waiting threads that the turn has changed.
-    // pthread_cond_broadcast is used here to wake up all threads waiting on this condition variable.
-    // Each thread will then check if it is their turn (based on currentPlayer) before taking action.
-    pthread_cond_broadcast(&game->turn_cond);
+    if (roundOver) {
+        // Once the round is won every player has to stop waiting, so wake each of them once
+        for (int i = 0; i < game->numPlayers; i++) {
+            Player *player = &game->players[i];
+            lockTracked(&player->turn_mutex, &player->turnLockStats);
+            player->roundOver = true;
+            pthread_cond_signal(&player->turn_cond);
+            unlockTracked(&player->turn_mutex, &player->turnLockStats);
+        }
+        return;
+    }
 
-    pthread_mutex_unlock(&game->turn_mutex); // Unlock the turn mutex
+    // Hand the token directly to the next player, waking only that player's thread.
+    // The rest of the table stays asleep, so the cost per turn does not grow with the player count.
+    Player *next = &game->players[nextPlayerId - 1];
+    lockTracked(&next->turn_mutex, &next->turnLockStats);
+    next->hasTurn = true;
+#ifdef LOCK_STATS
+    next->signaledAt = statsNowNs(); // Start of the handoff latency
+#endif
+    pthread_cond_signal(&next->turn_cond);
+    unlockTracked(&next->turn_mutex, &next->turnLockStats);
 }
 
-void waitForTurn(GameState *game, int playerId) {
-    pthread_mutex_lock(&game->turn_mutex); // Lock the turn mutex to ensure thread-safe access to the shared game state
+bool waitForTurn(GameState *game, int playerId) {
+    Player *player = &game->players[playerId - 1];
+    lockTracked(&player->turn_mutex, &player->turnLockStats); // Lock this player's turn mutex to read its token
 
-    // Continuously check if it's the player's turn.
+    // Wait until the token is handed over or the round has been won.
     // The while loop is used instead of an if statement to handle spurious wake-ups.
-    while (game->currentPlayer != playerId) {
-        // If it's not this player's turn, wait on the turn condition variable.
+    while (!player->hasTurn && !player->roundOver) {
         // pthread_cond_wait atomically unlocks the mutex and waits for the condition variable to be signaled.
         // When pthread_cond_wait returns (after being signaled), the mutex is automatically re-locked.
-        pthread_cond_wait(&game->turn_cond, &game->turn_mutex);
+        condWaitTracked(&player->turn_cond, &player->turn_mutex, &player->turnLockStats);
+#ifdef LOCK_STATS
+        if (!player->hasTurn && !player->roundOver) {
+            player->spuriousWakeups++;
+        }
+#endif
+    }
+    bool myTurn = !player->roundOver;
+#ifdef LOCK_STATS
+    // Handoff latency: from the previous player setting the token to this thread holding it
+    if (myTurn && player->hasTurn) {
+        long long latency = statsNowNs() - player->signaledAt;
+        player->turnsTaken++;
+        player->turnLatencyNs += latency;
+        if (latency > player->turnLatencyMaxNs) {
+            player->turnLatencyMaxNs = latency;
+        }
     }
+#endif
+    // Consume the token so the next wait blocks until it comes around again
+    player->hasTurn = false;
 
-    pthread_mutex_unlock(&game->turn_mutex); // Unlock the turn mutex
+    unlockTracked(&player->turn_mutex, &player->turnLockStats); // Unlock the turn mutex
+    return myTurn;
 }
 
-void logAction(const char* action) {
-    pthread_mutex_lock(&game.log_mutex); // Lock the log mutex to ensure thread-safe access to the log file
+void resetTurns(GameState *game) {
+    // Called by the dealer while the player threads are parked at the round barrier (or not yet
+    // started); the barrier orders these writes before the round, so no lock is needed
+    for (int i = 0; i < game->numPlayers; i++) {
+        game->players[i].hasTurn = false;
+        game->players[i].roundOver = false;
+    }
+    // The round opens with whoever holds the turn from the previous round
+    game->players[game->currentPlayer - 1].hasTurn = true;
+#ifdef LOCK_STATS
+    game->players[game->currentPlayer - 1].signaledAt = statsNowNs(); // Includes the wait at the round barrier
+#endif
+}
 
-    // Check if the log file is open
-    if (game.log_file) {
-        // Write the action string to the log file
-        fprintf(game.log_file, "%s\n", action);
+void logAction(GameState *game, const char* action) {
+    // Check if the game is being logged
+    if (!game->log) {
+        return;
+    }
 
-        // Flush the output buffer to ensure that the action is written to the file immediately
-        // This is important in a multithreaded environment to ensure logs are written in real-time
-        fflush(game.log_file);
+    // Copy the action into the ring, the writer thread does the file I/O.
+    // Long records (a DECK line from a big shoe) take several consecutive slots,
+    // claimed together so nothing can land in between.
+    size_t length = strlen(action);
+    size_t count = (length + 1 + LOG_RECORD_SIZE - 1) / LOG_RECORD_SIZE;
+    if (count > LOG_RING_CAPACITY) {
+        count = LOG_RING_CAPACITY;
+        length = count * LOG_RECORD_SIZE - 1;
     }
+    size_t pos = claimLogPositions(game->log, count);
 
-    pthread_mutex_unlock(&game.log_mutex); // Unlock the log mutex
+    for (size_t i = 0; i < count; i++) {
+        LogSlot *slot = waitForLogSlot(game->log, pos + i);
+        size_t offset = i * LOG_RECORD_SIZE;
+        size_t chunk = length - offset;
+        if (chunk > LOG_RECORD_SIZE) {
+            chunk = LOG_RECORD_SIZE;
+        }
+        memcpy(slot->text, action + offset, chunk);
+        // The newline goes after the last chunk
+        if (i == count - 1) {
+            slot->text[chunk++] = '\n';
+        }
+        slot->length = (int)chunk;
+        commitLogSlot(slot, pos + i);
+    }
 }
 
-void shuffleDeck(Card deck[]) {
-    // Loop through the deck from the end to the beginning
-    for (int i = NUM_CARDS - 1; i > 0; --i) {
-        // Generate a random number between 0 and i (inclusive)
-        int j = rand() % (i + 1);
-
-        // Swap the card at index i with the card at the randomly chosen index j
-        Card temp = deck[i];  // Store the current card in a temporary variable
-        deck[i] = deck[j];    // Move the card at index j to index i
-        deck[j] = temp;       // Move the card from the temporary variable to index j
+void logActionf(GameState *game, const char* format, ...) {
+    // Skip formatting entirely when the game has no log
+    if (!game->log) {
+        return;
     }
-}
-void dealCards(GameState *game) {
-    // Loop through all the players in the game
-    for (int i = 0; i < game->numPlayers; ++i) {
-        // Draw a card from the deck and assign it to the player's hand
-        // Increment the player's hand size after assigning the card
-        game->players[i].hand[game->players[i].hand_size++] = drawCard(game);
 
-        // You can log the action of dealing a card to each player if desired
-        // For example: Log the player ID and the card they received
+    // Format straight into the reserved slot to avoid an extra copy
+    size_t pos = claimLogPositions(game->log, 1);
+    LogSlot *slot = waitForLogSlot(game->log, pos);
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(slot->text, LOG_RECORD_SIZE - 1, format, args);
+    va_end(args);
+    if (length < 0) {
+        length = 0;
+    } else if (length > LOG_RECORD_SIZE - 2) {
+        length = LOG_RECORD_SIZE - 2;
     }
+    slot->text[length] = '\n';
+    slot->length = length + 1;
+    commitLogSlot(slot, pos);
 }
-Card drawCard(GameState* game) {
-    // Lock the mutex to ensure thread-safe access to the deck
-    pthread_mutex_lock(&game->deck_mutex);
 
-    // Check if the deck is empty
-    if (game->deck_size == 0) {
-        // Unlock the mutex before exiting the function
-        pthread_mutex_unlock(&game->deck_mutex);
-
-        // Handle the empty deck situation
-        fprintf(stderr, "The deck is empty, cannot draw a card.\n");
-        // Terminate the program if the deck is empty - you might want to handle this differently
-        exit(EXIT_FAILURE);
+void emitEvent(GameState *game, int type, int player, uint8_t card, uint32_t value) {
+    // Skip entirely when the game records no events
+    if (!game->events) {
+        return;
     }
 
-    // Draw the top card from the deck
-    Card drawnCard = game->deck[game->deck_size - 1];
-    // Decrement the deck size to indicate that a card has been drawn
-    game->deck_size--;
+    // Only the token holder or the dealer emits, so the buffer needs no lock
+    if (game->eventCount == game->eventCapacity) {
+        size_t capacity = game->eventCapacity ? game->eventCapacity * 2 : 1024;
+        GameEvent *buffer = realloc(game->eventBuffer, capacity * sizeof(GameEvent));
+        if (!buffer) {
+            perror("Error growing the event buffer");
+            exit(EXIT_FAILURE);
+        }
+        game->eventBuffer = buffer;
+        game->eventCapacity = capacity;
+    }
+    GameEvent *event = &game->eventBuffer[game->eventCount++];
+    event->type = (uint8_t)type;
+    event->card = card;
+    event->player = (uint16_t)player;
+    event->value = value;
+}
 
-    // Unlock the mutex after accessing the deck
-    pthread_mutex_unlock(&game->deck_mutex);
+void emitShoe(GameState *game) {
+    if (!game->events) {
+        return;
+    }
 
-    // Return the drawn card
-    return drawnCard;
+    // Record the freshly shuffled shoe, bottom first, so replay can rebuild every DECK line
+    for (int i = 0; i < game->shoeSize; i += EVENT_SHOE_CARDS) {
+        uint8_t packed[EVENT_SHOE_CARDS] = {0};
+        for (int j = 0; j < EVENT_SHOE_CARDS && i + j < game->shoeSize; j++) {
+            packed[j] = packCardByte(game->shoe[i + j]);
+        }
+        emitEvent(game, EVENT_SHOE, 0, packed[0],
+                  (uint32_t)packed[1] | ((uint32_t)packed[2] << 8) | ((uint32_t)packed[3] << 16) | ((uint32_t)packed[4] << 24));
+    }
 }
 
-void initializeGame(GameState *game, int numPlayers, int numChips) {
-    // Reset the game state to zero. This clears all values, ensuring a clean start.
-    memset(game, 0, sizeof(GameState));
+void flushGameEvents(GameState *game) {
+    if (!game->events || game->eventCount == 0) {
+        return;
+    }
 
-    // Initialize the deck of cards
-    initializeDeck(game->deck);
-    game->deck_size = NUM_CARDS; // Set the initial deck size
+    // A sink without a file leaves the events in the game's buffer for the caller to inspect
+    if (!game->events->file) {
+        return;
+    }
+    appendEvents(game->events, game->eventBuffer, game->eventCount, 1);
+    game->eventCount = 0;
+}
 
-    // Set basic game parameters
-    game->numPlayers = numPlayers; // Number of players in the game
-    game->totalRounds = numPlayers; // Assuming a round for each player
-    game->chips_in_bag = numChips; // Number of chips in the bag
-    game->numChips = numChips;     // Total number of chips
-    game->currentPlayer = 1;       // Start with player 1
-    game->dealerId = game->currentPlayer; // The first dealer is the first player
-    game->round = 1; // Start at round 1
-    game->total_bags_used = 1; // Start with the first bag of chips
-
-    // Open the log file for recording game actions
-    game->log_file = fopen("game_log.txt", "w");
-    if (!game->log_file) {
-        // Handle file open errors
-        perror("Error opening log file");
-        exit(EXIT_FAILURE);
+// One specialized engine per rule variant
+#define DEFINE_RULE_ENGINE(name, hand, decks, discard) \
+    void fastPlay_##name(FastGame *fast, uint64_t seed) { \
+        _Static_assert((hand) >= 2 && (hand) <= MAX_HAND_SIZE, #name ": hand size out of range"); \
+        _Static_assert((decks) >= 0, #name ": negative deck count"); \
+        _Static_assert(sizeof(#name) <= SNAPSHOT_NAME_BYTES, #name ": name too long for a snapshot header"); \
+        fastPlayRules(fast, seed, (hand), (discard)); \
+    } \
+    void fastPlayRound_##name(FastGame *fast) { \
+        fastPlayRound(fast, (hand), (discard)); \
     }
+RULE_VARIANTS(DEFINE_RULE_ENGINE)
 
-    // Initialize mutexes and condition variables
-    pthread_mutex_init(&game->deck_mutex, NULL); // Mutex for deck access
-    pthread_mutex_init(&game->turn_mutex, NULL); // Mutex for turn control
-    pthread_cond_init(&game->turn_cond, NULL);   // Condition variable for turns
-    pthread_mutex_init(&game->log_mutex, NULL);  // Mutex for logging actions
-    pthread_mutex_init(&game->chip_mutex, NULL); // Mutex for chip bag access
+// The registry: every variant with its engine, the classic rules first
+#define RULE_ENTRY(name, hand, decks, discard) { #name, (hand), (decks), (discard), fastPlay_##name, fastPlayRound_##name },
+const RuleVariant ruleVariants[] = { RULE_VARIANTS(RULE_ENTRY) };
+#define NUM_RULE_VARIANTS ((int)(sizeof(ruleVariants) / sizeof(ruleVariants[0])))
 
-    // Initialize player data
-    for (int i = 0; i < numPlayers; i++) {
-        game->players[i].id = i + 1; // Assign player IDs starting from 1
-        game->players[i].hand_size = 0; // Initialize each player's hand size to 0
+const RuleVariant* findRuleVariant(const char *name) {
+    for (int i = 0; i < NUM_RULE_VARIANTS; i++) {
+        if (strcmp(ruleVariants[i].name, name) == 0) {
+            return &ruleVariants[i];
+        }
     }
+    return NULL;
 }
 
-void initializeDeck(Card deck[NUM_CARDS]) {
-    // Define the four suits of a standard card deck
-    const char suits[] = {'H', 'D', 'C', 'S'}; // Hearts, Diamonds, Clubs, Spades
+int shoeDecksForRules(const RuleVariant *rules, int numPlayers) {
+    // A fixed shoe is used as given; runSweep has already checked the table fits
+    return rules->decksPerShoe > 0 ? rules->decksPerShoe : shoeDecksFor(numPlayers, rules->handSize);
+}
 
-    int index = 0; // Initialize index to track position in the deck array
+int runSweep(uint64_t seed, int numPlayers, int numChips, long long numGames, int numWorkers,
+             const char *names[], int numNames) {
+    // No names sweeps every registered variant
+    int count = numNames > 0 ? numNames : NUM_RULE_VARIANTS;
+    for (int i = 0; i < count; i++) {
+        const RuleVariant *rules = numNames > 0 ? findRuleVariant(names[i]) : &ruleVariants[i];
+        if (!rules) {
+            fprintf(stderr, "Unknown rule variant %s; known variants:", names[i]);
+            for (int v = 0; v < NUM_RULE_VARIANTS; v++) {
+                fprintf(stderr, " %s", ruleVariants[v].name);
+            }
+            fprintf(stderr, "\n");
+            return 1;
+        }
+        static const char* const policies[] = { "random", "oldest", "highest" };
+        printf("%sRules: %s (hand of %d, ", i > 0 ? "\n" : "", rules->name, rules->handSize);
+        if (rules->decksPerShoe > 0) {
+            printf("%d-deck shoe, %s discard)\n", rules->decksPerShoe, policies[rules->discardPolicy]);
+        } else {
+            printf("shoe sized to the table, %s discard)\n", policies[rules->discardPolicy]);
+        }
 
-    // Loop through each suit
-    for (int suit = 0; suit < 4; ++suit) {
-        // Loop through each card value (1 to 13, corresponding to Ace, 2-10, Jack, Queen, King)
-        for (int value = 1; value <= 13; ++value) {
-            deck[index].suit = suits[suit]; // Assign the suit to the current card
-            deck[index].value = value;      // Assign the value to the current card
-            index++; // Move to the next position in the deck array
+        // A fixed shoe must hold every card the table can have out at once
+        int needed = shoeDecksFor(numPlayers, rules->handSize);
+        if (rules->decksPerShoe > 0 && rules->decksPerShoe < needed) {
+            printf("Skipped: %d players need at least %d decks\n", numPlayers, needed);
+            continue;
+        }
+        if (runBatch(seed, numPlayers, numChips, numGames, numWorkers, rules, NULL, NULL, NULL) != 0) {
+            return 1;
         }
     }
-    // After the loop, the deck array is filled with 52 cards, in order of suits and values.
+    return 0;
 }
 
-void cleanup(GameState *game) {
-    // Check if the log file is open
-    if (game->log_file) {
-        fclose(game->log_file); // Close the log file
+void appendEvents(EventSink *sink, const GameEvent events[], size_t count, long long games) {
+    // One append per game, or per run of whole games, keeps games from different threads apart in the file
+    pthread_mutex_lock(&sink->mutex);
+    if (fwrite(events, sizeof(GameEvent), count, sink->file) != count) {
+        perror("Error writing game events");
     }
+    sink->eventsWritten += (long long)count;
+    sink->gamesWritten += games;
+    sink->fileBytes += count * sizeof(GameEvent);
+    pthread_mutex_unlock(&sink->mutex);
+}
 
-    // Destroy the mutexes
-    pthread_mutex_destroy(&game->deck_mutex); // Destroys the mutex for deck access
-    pthread_mutex_destroy(&game->log_mutex);  // Destroys the mutex for log file access
-    pthread_mutex_destroy(&game->turn_mutex); // Destroys the mutex for turn control
+EventSink* openEventSink(const char *path) {
+    EventSink *sink = calloc(1, sizeof(EventSink));
+    if (!sink) {
+        return NULL;
+    }
+    sink->file = fopen(path, "wb");
+    if (!sink->file) {
+        free(sink);
+        return NULL;
+    }
+    pthread_mutex_init(&sink->mutex, NULL);
 
-    // Destroy the condition variable
-    pthread_cond_destroy(&game->turn_cond);   // Destroys the condition variable for turn signaling
+    // The stream starts with a record identifying the format
+    GameEvent magic = { EVENT_MAGIC, EVENT_FORMAT_VERSION, 0, EVENT_MAGIC_VALUE };
+    fwrite(&magic, sizeof(magic), 1, sink->file);
+    sink->fileBytes = sizeof(magic);
+    return sink;
+}
 
-    // You can add more cleanup code here if there are other resources to release
+void closeEventSink(EventSink *sink) {
+    fclose(sink->file);
+    pthread_mutex_destroy(&sink->mutex);
+    free(sink);
 }
 
-void discardCard(GameState *game, Player* player, Card card) {
-    // Lock the deck mutex to ensure exclusive access to the deck
-    pthread_mutex_lock(&game->deck_mutex);
+size_t claimLogPositions(AsyncLog *log, size_t count) {
+    // Claiming positions is a single atomic add; positions define the total order of the log
+    return atomic_fetch_add_explicit(&log->enqueuePos, count, memory_order_relaxed);
+}
 
-    // Add the discarded card to the bottom of the deck
-    for (int i = game->deck_size; i > 0; i--) {
-        game->deck[i] = game->deck[i - 1]; // Shift all cards up by one position
+LogSlot* waitForLogSlot(AsyncLog *log, size_t pos) {
+    LogSlot *slot = &log->slots[pos & (LOG_RING_CAPACITY - 1)];
+
+#ifdef LOCK_STATS
+    // Count every claim, and time the ones that found the ring full
+    atomic_fetch_add_explicit(&log->slotStats.acquisitions, 1, memory_order_relaxed);
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos) {
+        long long start = statsNowNs();
+        while (atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos) {
+            sched_yield();
+        }
+        atomic_fetch_add_explicit(&log->slotStats.contended, 1, memory_order_relaxed);
+        statsRecord(log->slotStats.waitHist, &log->slotStats.waitNs, &log->slotStats.waitMaxNs, statsNowNs() - start);
     }
-    game->deck[0] = card; // Place the discarded card at the bottom of the deck
-    game->deck_size++; // Increment the deck size to account for the new card
+#endif
 
-    // Unlock the deck mutex after modifying the deck
-    pthread_mutex_unlock(&game->deck_mutex);
+    // If the ring is full, wait for the writer to release this slot
+    while (atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos) {
+        sched_yield();
+    }
+    return slot;
 }
 
-void declareWinner(GameState* game, Player* winner) {
-    // Create a log message stating the winner of the round
-    char log_message[128];
-    sprintf(log_message, "PLAYER %d: wins round %d", winner->id, game->round);
-
-    // Log this action by calling logAction
-    logAction(log_message);
-
-    // Call declareLosers to log the other players as having lost the round
-    declareLosers(game, winner->id);
+#ifdef LOCK_STATS
+long long statsNowNs(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
 }
 
-void declareLosers(GameState* game, int winnerId) {
-    char log_message[128];
+void statsRecord(_Atomic long long hist[], _Atomic long long *total, _Atomic long long *max, long long ns) {
+    // Bucket b counts durations below 2^b ns
+    int bucket = 0;
+    while (bucket < LOCK_HIST_BUCKETS - 1 && (1LL << bucket) <= ns) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&hist[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(total, ns, memory_order_relaxed);
 
-    // Iterate through all players in the game
-    for (int i = 0; i < game->numPlayers; i++) {
-        // Check if the current player is not the winner
-        if (game->players[i].id != winnerId) {
-            // Create a log message for each player who did not win
-            sprintf(log_message, "PLAYER %d: lost round %d", game->players[i].id, game->round);
+    long long seen = atomic_load_explicit(max, memory_order_relaxed);
+    while (ns > seen && !atomic_compare_exchange_weak_explicit(max, &seen, ns, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
 
-            // Log the message using the logAction function
-            logAction(log_message);
-        }
+void trackedLock(pthread_mutex_t *mutex, LockStats *stats) {
+    // Only a failed trylock counts as contention, so uncontended acquisitions take no timestamps for the wait
+    if (pthread_mutex_trylock(mutex) != 0) {
+        long long start = statsNowNs();
+        pthread_mutex_lock(mutex);
+        stats->heldSince = statsNowNs();
+        atomic_fetch_add_explicit(&stats->contended, 1, memory_order_relaxed);
+        statsRecord(stats->waitHist, &stats->waitNs, &stats->waitMaxNs, stats->heldSince - start);
+    } else {
+        stats->heldSince = statsNowNs();
     }
+    atomic_fetch_add_explicit(&stats->acquisitions, 1, memory_order_relaxed);
 }
 
-void openNewBag(GameState *game) {
-    // Reset the number of chips in the bag to the initial count
-    game->chips_in_bag = game->numChips;
+void trackedUnlock(pthread_mutex_t *mutex, LockStats *stats) {
+    statsRecord(stats->holdHist, &stats->holdNs, &stats->holdMaxNs, statsNowNs() - stats->heldSince);
+    pthread_mutex_unlock(mutex);
+}
 
-    // Increment the count of total bags used in the game
-    game->total_bags_used++;
+void trackedCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex, LockStats *stats) {
+    // The mutex is released while waiting, so close the hold interval and open a new one on wake-up
+    statsRecord(stats->holdHist, &stats->holdNs, &stats->holdMaxNs, statsNowNs() - stats->heldSince);
+    pthread_cond_wait(cond, mutex);
+    stats->heldSince = statsNowNs();
+}
 
-    // Log the event of opening a new bag of chips and the current number of chips in it
-    fprintf(game->log_file, "New bag of chips opened\nBAG: %d Chips left\n", game->chips_in_bag);
+void mergeLockStats(LockStats *into, const LockStats *from) {
+    atomic_fetch_add(&into->acquisitions, atomic_load(&from->acquisitions));
+    atomic_fetch_add(&into->contended, atomic_load(&from->contended));
+    atomic_fetch_add(&into->waitNs, atomic_load(&from->waitNs));
+    atomic_fetch_add(&into->holdNs, atomic_load(&from->holdNs));
+    if (atomic_load(&from->waitMaxNs) > atomic_load(&into->waitMaxNs)) {
+        atomic_store(&into->waitMaxNs, atomic_load(&from->waitMaxNs));
+    }
+    if (atomic_load(&from->holdMaxNs) > atomic_load(&into->holdMaxNs)) {
+        atomic_store(&into->holdMaxNs, atomic_load(&from->holdMaxNs));
+    }
+    for (int b = 0; b < LOCK_HIST_BUCKETS; b++) {
+        atomic_fetch_add(&into->waitHist[b], atomic_load(&from->waitHist[b]));
+        atomic_fetch_add(&into->holdHist[b], atomic_load(&from->holdHist[b]));
+    }
 }
-void eatChips(GameState *game, Player *player) {
-    // Lock the mutex to ensure exclusive access to the chips
-    pthread_mutex_lock(&game->chip_mutex);
 
-    // Randomly determine the number of chips to eat, between 1 and 5
-    int chips_to_eat = (rand() % 5) + 1;
+void printLockStats(const char *name, const LockStats *stats) {
+    long long acquisitions = atomic_load(&stats->acquisitions);
+    long long contended = atomic_load(&stats->contended);
+    long long holds = 0;
+    for (int b = 0; b < LOCK_HIST_BUCKETS; b++) {
+        holds += atomic_load(&stats->holdHist[b]);
+    }
 
-    // If the bag is empty, open a new bag of chips
-    if (game->chips_in_bag <= 0) {
-        openNewBag(game);
+    fprintf(stderr, "  %-18s %10lld acquired %10lld contended (%5.2f%%)  wait avg %8.0f ns max %10lld ns",
+            name, acquisitions, contended, acquisitions ? 100.0 * contended / acquisitions : 0.0,
+            contended ? (double)atomic_load(&stats->waitNs) / contended : 0.0, atomic_load(&stats->waitMaxNs));
+    if (holds > 0) {
+        fprintf(stderr, "  hold avg %6.0f ns max %10lld ns", (double)atomic_load(&stats->holdNs) / holds,
+                atomic_load(&stats->holdMaxNs));
     }
+    fprintf(stderr, "\n");
 
-    // If the number of chips to eat is more than what's left in the bag, adjust it
-    if (chips_to_eat > game->chips_in_bag) {
-        chips_to_eat = game->chips_in_bag;
+    // Histograms list only the non-empty buckets, each labelled with its upper bound
+    const _Atomic long long *hists[2] = { stats->waitHist, stats->holdHist };
+    const char *labels[2] = { "wait", "hold" };
+    for (int h = 0; h < 2; h++) {
+        bool any = false;
+        for (int b = 0; b < LOCK_HIST_BUCKETS; b++) {
+            long long n = atomic_load(&hists[h][b]);
+            if (n == 0) {
+                continue;
+            }
+            if (!any) {
+                fprintf(stderr, "    %s <ns:", labels[h]);
+                any = true;
+            }
+            fprintf(stderr, " %lld:%lld", 1LL << b, n);
+        }
+        if (any) {
+            fprintf(stderr, "\n");
+        }
     }
+}
 
-    // Subtract the eaten chips from the bag
-    game->chips_in_bag -= chips_to_eat;
+void reportLockStats(GameState *game) {
+    // Counters accumulate over every game played on this GameState
+    fprintf(stderr, "Lock stats (%d players, last seed %llu):\n", game->numPlayers, (unsigned long long)game->seed);
+#ifndef LOCK_FREE_DECK
+    printLockStats("deck_mutex", &game->deckLockStats);
+#endif
+    printLockStats("chip_mutex", &game->chipLockStats);
 
-    // Log the action of the player eating chips and the remaining chips in the bag
-    fprintf(game->log_file, "PLAYER %d: eats %d chips\n", player->id, chips_to_eat);
-    fprintf(game->log_file, "BAG: %d Chips left\n", game->chips_in_bag);
+    // The turn mutexes are reported together, the turn latency per player
+    LockStats turnStats;
+    memset(&turnStats, 0, sizeof(turnStats));
+    long long spurious = 0;
+    for (int i = 0; i < game->numPlayers; i++) {
+        mergeLockStats(&turnStats, &game->players[i].turnLockStats);
+        spurious += game->players[i].spuriousWakeups;
+    }
+    printLockStats("turn_mutex (all)", &turnStats);
+    if (game->log) {
+        printLockStats("log ring slots", &game->log->slotStats);
+    }
+    fprintf(stderr, "  waitForTurn spurious wake-ups: %lld\n", spurious);
 
-    // Unlock the mutex
-    pthread_mutex_unlock(&game->chip_mutex);
+    for (int i = 0; i < game->numPlayers; i++) {
+        Player *player = &game->players[i];
+        if (player->turnsTaken > 0) {
+            fprintf(stderr, "  Player %d: %lld turns, handoff latency avg %.0f ns max %lld ns\n", player->id,
+                    player->turnsTaken, (double)player->turnLatencyNs / player->turnsTaken, player->turnLatencyMaxNs);
+        }
+    }
 }
+#endif
 
-void startRound(GameState *game) {
-    // Log the start of the round with the current dealer's ID
-    fprintf(game->log_file, "Player %d: Round starts\n", game->dealerId);
-    fflush(game->log_file);  // Ensure the log is updated immediately
+void commitLogSlot(LogSlot *slot, size_t pos) {
+    // Publish the record to the writer thread
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+}
 
-    // Shuffle the deck to randomize the card order
-    shuffleDeck(game->deck);
-    game->deck_size = NUM_CARDS; // Reset the deck size back to full
+void* logWriterRoutine(void *arg) {
+    AsyncLog *log = (AsyncLog*)arg;
+    struct timespec lastWrite;
+    timespec_get(&lastWrite, TIME_UTC);
 
-    // Draw a card to determine the "Greasy Card" for this round
-    game->greasyCard = drawCard(game);
-    // Log the drawn "Greasy Card" using its string representation (A, J, Q, K for 1, 11, 12, 13)
-    fprintf(game->log_file, "Player %d: draws Greasy card %s\n",
-            game->dealerId, cardValueStr(game->greasyCard.value));
+    for (;;) {
+        // Drain ready records in position order into the batch buffer
+        int drained = 0;
+        while (log->batchLength + LOG_RECORD_SIZE <= LOG_BATCH_BYTES) {
+            LogSlot *slot = &log->slots[log->dequeuePos & (LOG_RING_CAPACITY - 1)];
+            if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != log->dequeuePos + 1) {
+                break; // The next record in order is not published yet
+            }
+            memcpy(log->batch + log->batchLength, slot->text, (size_t)slot->length);
+            log->batchLength += (size_t)slot->length;
+            // Hand the slot back to the producer that will claim it one lap later
+            atomic_store_explicit(&slot->sequence, log->dequeuePos + LOG_RING_CAPACITY, memory_order_release);
+            log->dequeuePos++;
+            log->recordsWritten++;
+            drained++;
+        }
 
-    // Deal one new card to each player
-    for (int i = 0; i < game->numPlayers; ++i) {
-        game->players[i].hand_size = 0; // Reset each player's hand size to 0
+        bool stopping = atomic_load_explicit(&log->stopping, memory_order_acquire);
+        // If the batch still has room, the drain stopped because the ring ran dry
+        bool batchFull = log->batchLength + LOG_RECORD_SIZE > LOG_BATCH_BYTES;
+        bool intervalDue = log->flushIntervalMs == 0 ||
+                           elapsedSeconds(&lastWrite) * 1000.0 >= log->flushIntervalMs;
 
-        // Draw a new card for the player
-        Card newCard = drawCard(game);
-        // Add the drawn card to the player's hand
-        game->players[i].hand[game->players[i].hand_size++] = newCard;
+        // Write the batch when it is full, when the flush policy says so, or on shutdown
+        if (log->batchLength > 0 && (batchFull || intervalDue || stopping)) {
+            fwrite(log->batch, 1, log->batchLength, log->file);
+            fflush(log->file);
+            log->batchLength = 0;
+            log->batchesWritten++;
+            timespec_get(&lastWrite, TIME_UTC);
+        }
+
+        if (drained == 0) {
+            // Producers are done once stopping is set, so an empty ring means everything is written
+            if (stopping && log->batchLength == 0 &&
+                atomic_load_explicit(&log->enqueuePos, memory_order_acquire) == log->dequeuePos) {
+                break;
+            }
+            struct timespec pause = {0, LOG_IDLE_SLEEP_NS};
+            nanosleep(&pause, NULL);
+        }
+    }
+    return NULL;
+}
+
+AsyncLog* openLog(const char *path, int flushIntervalMs) {
+    AsyncLog *log = calloc(1, sizeof(AsyncLog));
+    if (!log) {
+        return NULL;
+    }
+    log->slots = calloc(LOG_RING_CAPACITY, sizeof(LogSlot));
+    log->batch = malloc(LOG_BATCH_BYTES);
+    log->file = fopen(path, "w");
+    if (!log->slots || !log->batch || !log->file) {
+        if (log->file) {
+            fclose(log->file);
+        }
+        free(log->slots);
+        free(log->batch);
+        free(log);
+        return NULL;
+    }
+    // The writer already batches, so stdio buffering would only add a copy
+    setvbuf(log->file, NULL, _IONBF, 0);
+    log->flushIntervalMs = flushIntervalMs;
+
+    // Slot i starts out free for the producer that claims position i
+    for (size_t i = 0; i < LOG_RING_CAPACITY; i++) {
+        atomic_init(&log->slots[i].sequence, i);
+    }
+    atomic_init(&log->enqueuePos, 0);
+    atomic_init(&log->stopping, false);
+
+    if (pthread_create(&log->writer, NULL, logWriterRoutine, log) != 0) {
+        fclose(log->file);
+        free(log->slots);
+        free(log->batch);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+void closeLog(AsyncLog *log) {
+    // Let the writer drain every outstanding record before closing the file
+    atomic_store_explicit(&log->stopping, true, memory_order_release);
+    pthread_join(log->writer, NULL);
+
+    fclose(log->file);
+    free(log->slots);
+    free(log->batch);
+    free(log);
+}
+
+uint64_t splitMix64(uint64_t *state) {
+    // Counter-based: the output is a pure function of the incremented counter
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void rngSeed(Rng *rng, uint64_t seed, uint64_t stream) {
+    // Each (seed, stream) pair starts from an unrelated point; stream 0 is the game, stream i is player i
+    uint64_t state = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitMix64(&state);
+    }
+}
+
+uint64_t rngNext(Rng *rng) {
+#ifdef RNG_SPLITMIX
+    return splitMix64(&rng->s[0]);
+#else
+    // xoshiro256**
+    uint64_t *s = rng->s;
+    uint64_t x = s[1] * 5;
+    uint64_t result = ((x << 7) | (x >> 57)) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return result;
+#endif
+}
+
+uint32_t rngBelow(Rng *rng, uint32_t bound) {
+    // Lemire's multiply-shift maps 32 random bits onto [0, bound) without a division;
+    // the rejection step removes the bias that a plain modulo would leave
+    uint64_t m = (rngNext(rng) >> 32) * (uint64_t)bound;
+    uint32_t low = (uint32_t)m;
+    if (low < bound) {
+        uint32_t threshold = (uint32_t)(-bound) % bound;
+        while (low < threshold) {
+            m = (rngNext(rng) >> 32) * (uint64_t)bound;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+void shuffleDeck(Card deck[], int count, Rng *rng) {
+    // Fisher-Yates: loop through the deck from the end to the beginning
+    for (int i = count - 1; i > 0; --i) {
+        // Generate a random number between 0 and i (inclusive)
+        int j = (int)rngBelow(rng, (uint32_t)i + 1);
+
+        // Swap the card at index i with the card at the randomly chosen index j
+        Card temp = deck[i];  // Store the current card in a temporary variable
+        deck[i] = deck[j];    // Move the card at index j to index i
+        deck[j] = temp;       // Move the card from the temporary variable to index j
+    }
+}
+void dealCards(GameState *game) {
+    // Loop through all the players in the game
+    for (int i = 0; i < game->numPlayers; ++i) {
+        // Draw a card from the deck and assign it to the player's hand
+        // Increment the player's hand size after assigning the card
+        handAdd(game, i, drawCard(game));
+
+        // You can log the action of dealing a card to each player if desired
+        // For example: Log the player ID and the card they received
+    }
+}
+Card drawCard(GameState* game) {
+    Card drawnCard;
+
+#ifdef LOCK_FREE_DECK
+    // Claim the top card with a single CAS on the deck state
+    bool drawn = lockFreeDraw(&game->deck, &drawnCard);
+#else
+    // Lock the mutex to ensure thread-safe access to the deck
+    lockTracked(&game->deck_mutex, &game->deckLockStats);
+    // Draw the top card from the deck
+    bool drawn = ringDraw(&game->deck, &drawnCard);
+    // Unlock the mutex after accessing the deck
+    unlockTracked(&game->deck_mutex, &game->deckLockStats);
+#endif
+
+    // Check if the deck was empty
+    if (!drawn) {
+        // Handle the empty deck situation
+        fprintf(stderr, "The deck is empty, cannot draw a card.\n");
+        // Terminate the program if the deck is empty - you might want to handle this differently
+        exit(EXIT_FAILURE);
+    }
+
+    // Return the drawn card
+    return drawnCard;
+}
+
+int shoeDecksFor(int numPlayers, int handSize) {
+    // Hands only reach full size on the turn they are discarded from, so the greasy card,
+    // handSize - 1 cards per player and the next draw must all fit in the shoe
+    return (numPlayers * (handSize - 1) + 2 + NUM_CARDS - 1) / NUM_CARDS;
+}
+
+int ringCapacityFor(int count) {
+    // Smallest power of two with at least one slot to spare
+    int capacity = 1;
+    while (capacity <= count) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+bool ringInit(CardRing *ring, int capacity) {
+    ring->cards = malloc((size_t)capacity * sizeof(PackedCard));
+    ring->mask = capacity - 1;
+    ring->bottom = 0;
+    ring->size = 0;
+    return ring->cards != NULL;
+}
+
+void ringFree(CardRing *ring) {
+    free(ring->cards);
+    ring->cards = NULL;
+}
+
+void ringLoad(CardRing *ring, const Card cards[], int count) {
+    // cards[0] becomes the bottom of the deck and cards[count - 1] the top
+    for (int i = 0; i < count; i++) {
+        ring->cards[i] = packCardByte(cards[i]);
+    }
+    ring->bottom = 0;
+    ring->size = count;
+}
+
+bool ringDraw(CardRing *ring, Card *card) {
+    if (ring->size == 0) {
+        return false;
+    }
+    // The top card sits size - 1 places above the bottom
+    *card = unpackCardByte(ring->cards[(ring->bottom + ring->size - 1) & ring->mask]);
+    ring->size--;
+    return true;
+}
+
+bool ringDiscard(CardRing *ring, Card card) {
+    if (ring->size == ring->mask + 1) {
+        return false;
+    }
+    // Step the bottom back one slot instead of shifting the whole deck up
+    ring->bottom = (ring->bottom - 1) & ring->mask;
+    ring->cards[ring->bottom] = packCardByte(card);
+    ring->size++;
+    return true;
+}
+
+PackedCard packCardByte(Card card) {
+    // Four bits of value and two of suit are all a card needs
+    static const char suits[] = "HDCS";
+    const char *suit = strchr(suits, card.suit);
+    return (PackedCard)(card.value | ((suit ? suit - suits : 0) << 4));
+}
+
+Card unpackCardByte(PackedCard packed) {
+    static const char suits[] = "HDCS";
+    Card card;
+    card.value = CARD_VALUE(packed);
+    card.suit = suits[(packed >> 4) & 3];
+    return card;
+}
+
+Card handCard(GameState *game, int seat, int slot) {
+    return unpackCardByte(game->handSlots[slot][seat]);
+}
+
+void handAdd(GameState *game, int seat, Card card) {
+    game->handSlots[game->handSizes[seat]++][seat] = packCardByte(card);
+}
+
+Card handRemove(GameState *game, int seat, int slot) {
+    // Shift the later cards down and clear the freed slot, empty slots must stay 0
+    Card card = handCard(game, seat, slot);
+    int size = game->handSizes[seat];
+    for (int i = slot; i < size - 1; i++) {
+        game->handSlots[i][seat] = game->handSlots[i + 1][seat];
+    }
+    game->handSlots[size - 1][seat] = 0;
+    game->handSizes[seat]--;
+    return card;
+}
+
+void handClear(GameState *game, int seat) {
+    for (int i = 0; i < HAND_SIZE; i++) {
+        game->handSlots[i][seat] = 0;
+    }
+    game->handSizes[seat] = 0;
+}
+
+bool handHasValue(GameState *game, int seat, int value) {
+    // Empty slots hold 0, which never matches a card value
+    bool found = false;
+    for (int i = 0; i < HAND_SIZE; i++) {
+        found |= CARD_VALUE(game->handSlots[i][seat]) == value;
+    }
+    return found;
+}
+
+size_t matchGreasyHands(PackedCard *const slots[], int handSize, const uint8_t greasyValues[], uint8_t matches[], size_t count) {
+    // matches[i] becomes 0xFF when hand i holds a card of value greasyValues[i], 0 otherwise.
+    // Each hand slot is a separate column, so one vector compare checks a slot of 16 or 32 hands.
+    // The fast engine checks a whole table with it while the hands fill up; the threaded game
+    // only ever looks at the hand of the player holding the turn.
+    size_t i = 0;
+    size_t found = 0;
+#if defined(__AVX2__)
+    const __m256i valueMask = _mm256_set1_epi8(0x0F);
+    for (; i + 32 <= count; i += 32) {
+        __m256i greasy = _mm256_loadu_si256((const __m256i*)(greasyValues + i));
+        __m256i hit = _mm256_setzero_si256();
+        for (int s = 0; s < handSize; s++) {
+            __m256i cards = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(slots[s] + i)), valueMask);
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(cards, greasy));
+        }
+        _mm256_storeu_si256((__m256i*)(matches + i), hit);
+        found += (size_t)__builtin_popcount((unsigned)_mm256_movemask_epi8(hit));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i valueMask = _mm_set1_epi8(0x0F);
+    for (; i + 16 <= count; i += 16) {
+        __m128i greasy = _mm_loadu_si128((const __m128i*)(greasyValues + i));
+        __m128i hit = _mm_setzero_si128();
+        for (int s = 0; s < handSize; s++) {
+            __m128i cards = _mm_and_si128(_mm_loadu_si128((const __m128i*)(slots[s] + i)), valueMask);
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(cards, greasy));
+        }
+        _mm_storeu_si128((__m128i*)(matches + i), hit);
+        int bits = _mm_movemask_epi8(hit);
+        for (; bits; bits &= bits - 1) {
+            found++;
+        }
+    }
+#endif
+    // Remaining hands, or all of them without vector support, branch-free per hand
+    for (; i < count; i++) {
+        uint8_t hit = 0;
+        for (int s = 0; s < handSize; s++) {
+            hit |= (uint8_t)-(CARD_VALUE(slots[s][i]) == greasyValues[i]);
+        }
+        matches[i] = hit;
+        found += hit & 1;
+    }
+    return found;
+}
+
+bool lockFreeInit(LockFreeDeck *deck, int capacity) {
+    deck->slots = calloc((size_t)capacity, sizeof(*deck->slots));
+    deck->mask = (uint32_t)capacity - 1;
+    atomic_init(&deck->state, 0);
+    return deck->slots != NULL;
+}
+
+void lockFreeFree(LockFreeDeck *deck) {
+    free((void*)deck->slots);
+    deck->slots = NULL;
+}
+
+// Field layout of LockFreeDeck.state
+#define LF_BOTTOM(state) ((uint32_t)((state) & 0xFFFFFF))
+#define LF_SIZE(state) ((uint32_t)(((state) >> 24) & 0xFFFFFF))
+#define LF_STATE(version, size, bottom) (((uint64_t)(version) << 48) | ((uint64_t)(size) << 24) | (uint64_t)(bottom))
+
+void lockFreeLoad(LockFreeDeck *deck, const Card cards[], int count) {
+    // Only called while no other thread is touching the deck
+    for (uint32_t i = 0; i <= deck->mask; i++) {
+        atomic_store_explicit(&deck->slots[i], (int)i < count ? packCardByte(cards[i]) : 0, memory_order_relaxed);
+    }
+    uint64_t version = (atomic_load_explicit(&deck->state, memory_order_relaxed) >> 48) + 1;
+    atomic_store_explicit(&deck->state, LF_STATE(version, count, 0), memory_order_release);
+}
+
+bool lockFreeDraw(LockFreeDeck *deck, Card *card) {
+    uint64_t state = atomic_load_explicit(&deck->state, memory_order_acquire);
+    uint32_t bottom, size;
+
+    // Shrink the deck by one; winning the CAS gives this thread the top slot
+    do {
+        bottom = LF_BOTTOM(state);
+        size = LF_SIZE(state);
+        if (size == 0) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&deck->state, &state,
+                 LF_STATE((state >> 48) + 1, size - 1, bottom),
+                 memory_order_acq_rel, memory_order_acquire));
+
+    // A discard that claimed this slot may still be writing its card, so wait for it to land
+    _Atomic PackedCard *slot = &deck->slots[(bottom + size - 1) & deck->mask];
+    PackedCard packed;
+    while ((packed = atomic_exchange_explicit(slot, 0, memory_order_acq_rel)) == 0) {
+        sched_yield();
+    }
+    *card = unpackCardByte(packed);
+    return true;
+}
+
+bool lockFreeDiscard(LockFreeDeck *deck, Card card) {
+    uint64_t state = atomic_load_explicit(&deck->state, memory_order_acquire);
+    uint32_t bottom, size;
+
+    // Grow the deck by one at the bottom; winning the CAS gives this thread the new bottom slot
+    do {
+        bottom = LF_BOTTOM(state);
+        size = LF_SIZE(state);
+        if (size == deck->mask) {
+            return false; // Keep one slot spare so a lagging drawer's slot is never reused
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&deck->state, &state,
+                 LF_STATE((state >> 48) + 1, size + 1, (bottom - 1) & deck->mask),
+                 memory_order_acq_rel, memory_order_acquire));
+
+    // Fill the slot once any drawer that claimed it earlier has emptied it
+    _Atomic PackedCard *slot = &deck->slots[(bottom - 1) & deck->mask];
+    PackedCard expected = 0;
+    while (!atomic_compare_exchange_weak_explicit(slot, &expected, packCardByte(card),
+                                                  memory_order_release, memory_order_relaxed)) {
+        expected = 0;
+        sched_yield();
+    }
+    return true;
+}
+
+bool allocateDeck(GameState *game) {
+    // Room for the whole shoe plus the spare slot the lock-free ring keeps
+    int capacity = ringCapacityFor(game->shoeSize);
+#ifdef LOCK_FREE_DECK
+    return lockFreeInit(&game->deck, capacity);
+#else
+    return ringInit(&game->deck, capacity);
+#endif
+}
+
+void freeDeck(GameState *game) {
+#ifdef LOCK_FREE_DECK
+    lockFreeFree(&game->deck);
+#else
+    ringFree(&game->deck);
+#endif
+}
+
+void loadDeck(GameState *game, const Card cards[], int count) {
+#ifdef LOCK_FREE_DECK
+    lockFreeLoad(&game->deck, cards, count);
+#else
+    ringLoad(&game->deck, cards, count);
+#endif
+}
+
+int deckSize(GameState *game) {
+#ifdef LOCK_FREE_DECK
+    return (int)LF_SIZE(atomic_load_explicit(&game->deck.state, memory_order_acquire));
+#else
+    return game->deck.size;
+#endif
+}
+
+Card deckCardAt(GameState *game, int index) {
+    // Card index places above the bottom; only meaningful while the deck is not being changed
+#ifdef LOCK_FREE_DECK
+    uint32_t bottom = LF_BOTTOM(atomic_load_explicit(&game->deck.state, memory_order_acquire));
+    return unpackCardByte(atomic_load_explicit(&game->deck.slots[(bottom + (uint32_t)index) & game->deck.mask], memory_order_acquire));
+#else
+    return unpackCardByte(game->deck.cards[(game->deck.bottom + index) & game->deck.mask]);
+#endif
+}
+
+GameState* allocateGame(int numPlayers) {
+    // The players live in the flexible array at the end of GameState
+    GameState *game = calloc(1, sizeof(GameState) + (size_t)numPlayers * sizeof(Player));
+    if (!game) {
+        perror("Error allocating game state");
+        exit(EXIT_FAILURE);
+    }
+    return game;
+}
+
+void initializeGame(GameState *game, int numPlayers, int numChips, uint64_t seed, const char *logPath, int logFlushMs) {
+    // Reset the game state to zero. This clears all values, ensuring a clean start.
+    memset(game, 0, sizeof(GameState) + (size_t)numPlayers * sizeof(Player));
+
+    // Set basic game parameters
+    game->numPlayers = numPlayers; // Number of players in the game
+    game->numChips = numChips;     // Total number of chips
+
+    // Size the shoe so every player can be dealt a hand, then allocate the deck and scratch buffers
+    game->numDecks = shoeDecksFor(numPlayers, HAND_SIZE);
+    game->shoeSize = game->numDecks * NUM_CARDS;
+    game->shoe = malloc((size_t)game->shoeSize * sizeof(Card));
+    game->deckLine = malloc((size_t)game->shoeSize * 3 + 16); // "DECK: " plus up to "10 " per card
+    for (int i = 0; i < HAND_SIZE; i++) {
+        game->handSlots[i] = calloc((size_t)numPlayers, sizeof(PackedCard));
+    }
+    game->handSizes = calloc((size_t)numPlayers, sizeof(uint8_t));
+    if (!game->shoe || !game->deckLine || !game->handSizes || !game->handSlots[HAND_SIZE - 1] ||
+        !game->handSlots[0] || !allocateDeck(game)) {
+        perror("Error allocating the deck");
+        exit(EXIT_FAILURE);
+    }
+
+    // Open the log for recording game actions, batch games run without one
+    if (logPath) {
+        game->log = openLog(logPath, logFlushMs);
+        if (!game->log) {
+            // Handle file open errors
+            perror("Error opening log file");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Initialize mutexes and condition variables
+    pthread_mutex_init(&game->deck_mutex, NULL); // Mutex for deck access
+    pthread_mutex_init(&game->chip_mutex, NULL); // Mutex for chip bag access
+    pthread_barrier_init(&game->round_barrier, NULL, (unsigned)numPlayers + 1); // Dealer plus players
+    for (int i = 0; i < numPlayers; i++) {
+        pthread_mutex_init(&game->players[i].turn_mutex, NULL); // Mutex for the player's turn token
+        pthread_cond_init(&game->players[i].turn_cond, NULL);   // Condition variable for the player's turn
+        // Set once here: the player threads read these before parking at the round barrier,
+        // so resetGame must not rewrite them under running threads
+        game->players[i].id = i + 1;      // Assign player IDs starting from 1
+        game->players[i].game = game;
+    }
+
+    resetGame(game, seed);
+}
+
+void resetGame(GameState *game, uint64_t seed) {
+    // Initialize the deck of cards
+    initializeShoe(game->shoe, game->numDecks);
+    loadDeck(game, game->shoe, game->shoeSize);
+
+    game->totalRounds = game->numPlayers; // Assuming a round for each player
+    game->chips_in_bag = game->numChips;  // Number of chips in the bag
+    game->chips_eaten = 0;
+    game->currentPlayer = 1;              // Start with player 1
+    game->dealerId = game->currentPlayer; // The first dealer is the first player
+    game->round = 1;                      // Start at round 1
+    game->total_bags_used = 1;            // Start with the first bag of chips
+    game->seed = seed;
+    rngSeed(&game->rng, seed, 0);          // Stream 0 belongs to the game itself
+
+    // Initialize player data
+    for (int i = 0; i < game->numPlayers; i++) {
+        handClear(game, i);               // Start each player with an empty hand
+        game->players[i].roundsWon = 0;
+        rngSeed(&game->players[i].rng, seed, (uint64_t)i + 1); // Stream i belongs to player i
+    }
+}
+
+void initializeDeck(Card deck[NUM_CARDS]) {
+    // Define the four suits of a standard card deck
+    const char suits[] = {'H', 'D', 'C', 'S'}; // Hearts, Diamonds, Clubs, Spades
+
+    int index = 0; // Initialize index to track position in the deck array
+
+    // Loop through each suit
+    for (int suit = 0; suit < 4; ++suit) {
+        // Loop through each card value (1 to 13, corresponding to Ace, 2-10, Jack, Queen, King)
+        for (int value = 1; value <= 13; ++value) {
+            deck[index].suit = suits[suit]; // Assign the suit to the current card
+            deck[index].value = value;      // Assign the value to the current card
+            index++; // Move to the next position in the deck array
+        }
+    }
+    // After the loop, the deck array is filled with 52 cards, in order of suits and values.
+}
+
+void initializeShoe(Card cards[], int numDecks) {
+    // A shoe is several complete decks stacked one after another
+    for (int i = 0; i < numDecks; i++) {
+        initializeDeck(cards + i * NUM_CARDS);
+    }
+}
+
+void cleanup(GameState *game) {
+#ifdef LOCK_STATS
+    // Summarize the lock counters while the log ring is still around
+    reportLockStats(game);
+#endif
+
+    // Check if the log is open
+    if (game->log) {
+        closeLog(game->log); // Drain the remaining records and close the log file
+        game->log = NULL;
+    }
+
+    // Destroy the mutexes
+    pthread_mutex_destroy(&game->deck_mutex); // Destroys the mutex for deck access
+    pthread_mutex_destroy(&game->chip_mutex); // Destroys the mutex for chip bag access
+    pthread_barrier_destroy(&game->round_barrier); // Destroys the round barrier
+
+    // Destroy each player's turn mutex and condition variable
+    for (int i = 0; i < game->numPlayers; i++) {
+        pthread_mutex_destroy(&game->players[i].turn_mutex);
+        pthread_cond_destroy(&game->players[i].turn_cond);
+    }
+
+    // Release the deck, scratch and event buffers
+    free(game->eventBuffer);
+    game->eventBuffer = NULL;
+    for (int i = 0; i < HAND_SIZE; i++) {
+        free(game->handSlots[i]);
+        game->handSlots[i] = NULL;
+    }
+    free(game->handSizes);
+    game->handSizes = NULL;
+    freeDeck(game);
+    free(game->shoe);
+    free(game->deckLine);
+    game->shoe = NULL;
+    game->deckLine = NULL;
+}
+
+void discardCard(GameState *game, Player* player, Card card) {
+#ifdef LOCK_FREE_DECK
+    // Place the discarded card at the bottom of the deck with a single CAS
+    bool discarded = lockFreeDiscard(&game->deck, card);
+#else
+    // Lock the deck mutex to ensure exclusive access to the deck
+    lockTracked(&game->deck_mutex, &game->deckLockStats);
+    // Place the discarded card at the bottom of the deck
+    bool discarded = ringDiscard(&game->deck, card);
+    // Unlock the deck mutex after modifying the deck
+    unlockTracked(&game->deck_mutex, &game->deckLockStats);
+#endif
+
+    if (!discarded) {
+        fprintf(stderr, "The deck is full, cannot discard a card.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void declareWinner(GameState* game, Player* winner) {
+    // Record the win for the seat's statistics
+    winner->roundsWon++;
+
+    // Log the winner of the round
+    logActionf(game, "PLAYER %d: wins round %d", winner->id, game->round);
+    emitEvent(game, EVENT_ROUND_WON, winner->id, 0, (uint32_t)game->round);
+
+    // Call declareLosers to log the other players as having lost the round
+    declareLosers(game, winner->id);
+}
+
+void declareLosers(GameState* game, int winnerId) {
+    // Iterate through all players in the game
+    for (int i = 0; i < game->numPlayers; i++) {
+        // Check if the current player is not the winner
+        if (game->players[i].id != winnerId) {
+            // Log each player who did not win
+            logActionf(game, "PLAYER %d: lost round %d", game->players[i].id, game->round);
+        }
+    }
+}
+
+void openNewBag(GameState *game) {
+    // Reset the number of chips in the bag to the initial count
+    game->chips_in_bag = game->numChips;
+
+    // Increment the count of total bags used in the game
+    game->total_bags_used++;
+
+    // Log the event of opening a new bag of chips and the current number of chips in it
+    logActionf(game, "New bag of chips opened\nBAG: %d Chips left", game->chips_in_bag);
+    emitEvent(game, EVENT_BAG_OPENED, 0, 0, (uint32_t)game->chips_in_bag);
+}
+void eatChips(GameState *game, Player *player) {
+    // Lock the mutex to ensure exclusive access to the chips
+    lockTracked(&game->chip_mutex, &game->chipLockStats);
+
+    // Randomly determine the number of chips to eat, between 1 and 5
+    int chips_to_eat = (int)rngBelow(&player->rng, 5) + 1;
+
+    // If the bag is empty, open a new bag of chips
+    if (game->chips_in_bag <= 0) {
+        openNewBag(game);
+    }
+
+    // If the number of chips to eat is more than what's left in the bag, adjust it
+    if (chips_to_eat > game->chips_in_bag) {
+        chips_to_eat = game->chips_in_bag;
+    }
+
+    // Subtract the eaten chips from the bag
+    game->chips_in_bag -= chips_to_eat;
+    game->chips_eaten += chips_to_eat;
+
+    // Log the action of the player eating chips and the remaining chips in the bag
+    logActionf(game, "PLAYER %d: eats %d chips\nBAG: %d Chips left", player->id, chips_to_eat, game->chips_in_bag);
+    emitEvent(game, EVENT_CHIPS_EATEN, player->id, 0, (uint32_t)chips_to_eat);
+
+    // Unlock the mutex
+    unlockTracked(&game->chip_mutex, &game->chipLockStats);
+}
+
+void startRound(GameState *game) {
+    // The event stream opens each game with its table size
+    if (game->round == 1) {
+        emitEvent(game, EVENT_GAME_START, game->numPlayers, 0, (uint32_t)game->numChips);
+    }
+
+    // Log the start of the round with the current dealer's ID
+    logActionf(game, "Player %d: Round starts", game->dealerId);
+    emitEvent(game, EVENT_ROUND_START, game->dealerId, 0, (uint32_t)game->round);
+
+    // Rebuild and shuffle the full deck to randomize the card order
+    initializeShoe(game->shoe, game->numDecks);
+    shuffleDeck(game->shoe, game->shoeSize, &game->rng);
+    loadDeck(game, game->shoe, game->shoeSize); // Reset the deck back to full
+    emitShoe(game);
+    resetTurns(game);
+
+    // Draw a card to determine the "Greasy Card" for this round
+    game->greasyCard = drawCard(game);
+    // Log the drawn "Greasy Card" using its string representation (A, J, Q, K for 1, 11, 12, 13)
+    logActionf(game, "Player %d: draws Greasy card %s", game->dealerId, cardValueStr(game->greasyCard.value));
+    emitEvent(game, EVENT_GREASY, game->dealerId, packCardByte(game->greasyCard), 0);
+
+    // Deal one new card to each player
+    for (int i = 0; i < game->numPlayers; ++i) {
+        handClear(game, i); // Empty each player's hand
+
+        // Draw a new card for the player
+        Card newCard = drawCard(game);
+        // Add the drawn card to the player's hand
+        handAdd(game, i, newCard);
+
+        // Log the card that was drawn for the player
+        logActionf(game, "PLAYER %d: draws %s", game->players[i].id, cardValueStr(newCard.value));
+        emitEvent(game, EVENT_DEAL, game->players[i].id, packCardByte(newCard), 0);
+    }
+}
+
+void endRound(GameState *game) {
+    // Log the end of the round with the current dealer's ID, plus a blank line for readability
+    logActionf(game, "Player %d: Round ends\n", game->dealerId);
+    emitEvent(game, EVENT_ROUND_END, game->dealerId, 0, 0);
+
+    // Update the dealer for the next round by cycling to the next player
+    game->dealerId = (game->dealerId % game->numPlayers) + 1;
+
+    // Increment the round number
+    game->round++;
+
+    // If all rounds have been played, log the game completion
+    if (game->round > game->totalRounds) {
+        logActionf(game, "Game completed after %d rounds.", game->totalRounds);
+        emitEvent(game, EVENT_GAME_END, 0, 0, (uint32_t)game->totalRounds);
+        flushGameEvents(game); // The game is complete, append it to the stream in one piece
+    }
+}
+
+bool playTurn(GameState *game, Player *player) {
+    int seat = player->id - 1;
+
+    // Draw a card if the player has less than 2 cards
+    if (game->handSizes[seat] < HAND_SIZE) {
+        Card drawnCard = drawCard(game);
+        handAdd(game, seat, drawnCard);
+        // Log the drawn card
+        logActionf(game, "PLAYER %d: draws %s", player->id, cardValueStr(drawnCard.value));
+        emitEvent(game, EVENT_DRAW, player->id, packCardByte(drawnCard), 0);
+    }
+
+    // Check if player's hand contains the Greasy card
+    bool hasGreasyCard = handHasValue(game, seat, game->greasyCard.value);
+
+    // Log the player's hand if it contains the Greasy card
+    if (hasGreasyCard) {
+        displayPlayerHand(game, player);
+        logActionf(game, " <> Greasy card is %s", cardValueStr(game->greasyCard.value));
+        emitEvent(game, EVENT_HOLDS_GREASY, player->id, 0, 0);
+    }
+
+    // Discard a card if the player doesn't have the Greasy card and hand is full
+    if (!hasGreasyCard && game->handSizes[seat] == HAND_SIZE) {
+        int randomIndex = (int)rngBelow(&player->rng, (uint32_t)game->handSizes[seat]);
+        // Remove the discarded card from hand
+        Card cardToDiscard = handRemove(game, seat, randomIndex);
+        // Log the discarded card
+        logActionf(game, "PLAYER %d: discards %s at random", player->id, cardValueStr(cardToDiscard.value));
+        emitEvent(game, EVENT_DISCARD, player->id, packCardByte(cardToDiscard), (uint32_t)randomIndex);
+
+        // Discard the card and update game state
+        discardCard(game, player, cardToDiscard);
+        displayPlayerHand(game, player);
+        logDeckContents(game);
+        eatChips(game, player);
+    } else if (hasGreasyCard) {
+        // Declare the player as the winner if they have the Greasy card
+        declareWinner(game, player);
+    }
+
+    return hasGreasyCard;
+}
+
+void* playerRoutine(void* arg) {
+    Player* player = (Player*)arg; // Cast the argument to a Player structure
+    GameState* game = player->game;
+
+    // The thread lives for the whole game and is parked at the round barrier between rounds
+    for (;;) {
+        // Wait for the dealer to open the next round
+        pthread_barrier_wait(&game->round_barrier);
+        if (game->gameOver) {
+            break;
+        }
+
+        // Keep taking turns until someone wins the round
+        while (waitForTurn(game, player->id)) {
+            bool wonRound = playTurn(game, player);
+
+            // Signal the next player's turn, or release everyone if the round is over
+            signalNextPlayerTurn(game, (player->id % game->numPlayers) + 1, wonRound);
+        }
+
+        // Tell the dealer this player is done with the round
+        pthread_barrier_wait(&game->round_barrier);
+    }
+    return NULL;
+}
+
+void startPlayerThreads(GameState *game) {
+    // Create one thread per player; they stay parked at the round barrier until a game is played,
+    // so back-to-back games on the same GameState reuse them
+    game->gameOver = false;
+    for (int i = 0; i < game->numPlayers; i++) {
+        int ret = pthread_create(&game->players[i].thread, NULL, playerRoutine, (void*)&game->players[i]);
+        if (ret != 0) {
+            perror("Failed to create the player thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void stopPlayerThreads(GameState *game) {
+    // Release the players one last time so they can exit
+    game->gameOver = true;
+    pthread_barrier_wait(&game->round_barrier);
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (pthread_join(game->players[i].thread, NULL) != 0) {
+            perror("Failed to join the player thread");
+        }
+    }
+}
+
+void playThreadedGame(GameState *game) {
+    // Main game loop to go through all the rounds, the player threads must already be running
+    while (game->round <= game->totalRounds) {
+        // Start a new round while the players are parked, then release them
+        startRound(game);
+        pthread_barrier_wait(&game->round_barrier);
+
+        // Wait for every player to see the round end before proceeding
+        pthread_barrier_wait(&game->round_barrier);
+
+        // End the current round and prepare for the next
+        endRound(game);
+    }
+}
+
+bool fastGameInit(FastGame *fast, int numPlayers, int numChips, const RuleVariant *rules, bool recordEvents) {
+    memset(fast, 0, sizeof(FastGame));
+    fast->numPlayers = numPlayers;
+    fast->numChips = numChips;
+    fast->rules = rules;
+    fast->shoeSize = shoeDecksForRules(rules, numPlayers) * NUM_CARDS;
+    fast->deckMask = ringCapacityFor(fast->shoeSize) - 1;
+    fast->recordEvents = recordEvents;
+
+    // Everything the game loop touches is allocated here, once per worker
+    fast->freshShoe = malloc((size_t)fast->shoeSize);
+    fast->deck = malloc((size_t)fast->deckMask + 1);
+    bool handsAllocated = true;
+    for (int i = 0; i < rules->handSize; i++) {
+        fast->handSlots[i] = calloc((size_t)numPlayers, sizeof(PackedCard));
+        handsAllocated &= fast->handSlots[i] != NULL;
+    }
+    fast->handSizes = calloc((size_t)numPlayers, sizeof(uint8_t));
+    fast->greasyValues = calloc((size_t)numPlayers, sizeof(uint8_t));
+    fast->greasyMatches = calloc((size_t)numPlayers, sizeof(uint8_t));
+    fast->playerRngs = calloc((size_t)numPlayers, sizeof(Rng));
+    fast->roundsWon = calloc((size_t)numPlayers, sizeof(int));
+    fast->roundResults = calloc((size_t)numPlayers, sizeof(RoundResult)); // One round per seat
+    if (!fast->freshShoe || !fast->deck || !handsAllocated || !fast->handSizes || !fast->greasyValues ||
+        !fast->greasyMatches || !fast->playerRngs || !fast->roundsWon || !fast->roundResults) {
+        return false;
+    }
+
+    // The same card order initializeShoe produces, already packed
+    Card cards[NUM_CARDS];
+    initializeDeck(cards);
+    for (int i = 0; i < fast->shoeSize; i++) {
+        fast->freshShoe[i] = packCardByte(cards[i % NUM_CARDS]);
+    }
+    return true;
+}
+
+void fastGameFree(FastGame *fast) {
+    free(fast->freshShoe);
+    free(fast->deck);
+    for (int i = 0; i < MAX_HAND_SIZE; i++) {
+        free(fast->handSlots[i]);
+    }
+    free(fast->handSizes);
+    free(fast->greasyValues);
+    free(fast->greasyMatches);
+    free(fast->playerRngs);
+    free(fast->roundsWon);
+    free(fast->roundResults);
+    free(fast->events);
+}
+
+void fastEmit(FastGame *fast, int type, int player, PackedCard card, uint32_t value) {
+    if (!fast->recordEvents) {
+        return;
+    }
+    // The buffer only grows until it holds the longest game seen, then it is reused
+    if (fast->eventCount == fast->eventCapacity) {
+        size_t capacity = fast->eventCapacity ? fast->eventCapacity * 2 : 1024;
+        GameEvent *events = realloc(fast->events, capacity * sizeof(GameEvent));
+        if (!events) {
+            perror("Error growing the event buffer");
+            exit(EXIT_FAILURE);
+        }
+        fast->events = events;
+        fast->eventCapacity = capacity;
+    }
+    GameEvent *event = &fast->events[fast->eventCount++];
+    event->type = (uint8_t)type;
+    event->card = card;
+    event->player = (uint16_t)player;
+    event->value = value;
+}
+
+PackedCard fastDraw(FastGame *fast) {
+    // The shoe always holds more cards than the table can have in hand, so the deck never runs dry
+    fast->deckSize--;
+    return fast->deck[(fast->deckBottom + fast->deckSize) & fast->deckMask];
+}
+
+void fastPlayGame(FastGame *fast, uint64_t seed) {
+    fast->rules->play(fast, seed);
+}
+
+void fastStartGame(FastGame *fast, uint64_t seed) {
+    // Same streams as resetGame: stream 0 for the dealer, stream i for player i
+    rngSeed(&fast->rng, seed, 0);
+    for (int i = 0; i < fast->numPlayers; i++) {
+        rngSeed(&fast->playerRngs[i], seed, (uint64_t)i + 1);
+        fast->roundsWon[i] = 0;
+    }
+    fast->rounds = 0;
+    fast->turns = 0;
+    fast->chipsEaten = 0;
+    fast->bagsUsed = 1;
+    fast->bagsBefore = 0; // The game's first bag is counted in round 1
+    fast->chipsInBag = fast->numChips;
+    fast->currentPlayer = 1;
+    fast->dealerId = 1;
+    fast->eventCount = 0;
+    fastEmit(fast, EVENT_GAME_START, fast->numPlayers, 0, (uint32_t)fast->numChips);
+}
+
+// The engine every rule variant is built from. Each generated fastPlay_<name>
+// and fastPlayRound_<name> calls it with its rules as constants, so the compiler
+// emits one specialized copy per variant; the classic rules play exactly like the
+// threaded game. One call plays the next round of the game fastStartGame began.
+static ALWAYS_INLINE void fastPlayRound(FastGame *fast, const int handSize, const int discardPolicy) {
+    int numPlayers = fast->numPlayers;
+    int round = fast->rounds + 1;
+    int chipsInBag = fast->chipsInBag;
+    int currentPlayer = fast->currentPlayer;
+    int dealerId = fast->dealerId;
+
+    fastEmit(fast, EVENT_ROUND_START, dealerId, 0, (uint32_t)round);
+    long long turnsBefore = fast->turns;
+    int chipsBefore = fast->chipsEaten;
+    RoundResult *result = &fast->roundResults[round - 1];
+    result->dealer = (uint32_t)dealerId;
+
+    // Fresh shoe, shuffled with exactly the draws shuffleDeck makes
+    PackedCard *deck = fast->deck;
+    memcpy(deck, fast->freshShoe, (size_t)fast->shoeSize);
+    for (int i = fast->shoeSize - 1; i > 0; --i) {
+        int j = (int)rngBelow(&fast->rng, (uint32_t)i + 1);
+        PackedCard temp = deck[i];
+        deck[i] = deck[j];
+        deck[j] = temp;
+    }
+    fast->deckBottom = 0;
+    fast->deckSize = fast->shoeSize;
+    if (fast->recordEvents) {
+        for (int i = 0; i < fast->shoeSize; i += EVENT_SHOE_CARDS) {
+            uint32_t rest = 0;
+            for (int j = 1; j < EVENT_SHOE_CARDS && i + j < fast->shoeSize; j++) {
+                rest |= (uint32_t)deck[i + j] << (8 * (j - 1));
+            }
+            fastEmit(fast, EVENT_SHOE, 0, deck[i], rest);
+        }
+    }
+
+    // Greasy card, then one card to every seat
+    PackedCard greasy = fastDraw(fast);
+    int greasyValue = CARD_VALUE(greasy);
+    result->greasyValue = (uint8_t)greasyValue;
+    memset(fast->greasyValues, greasyValue, (size_t)numPlayers);
+    fastEmit(fast, EVENT_GREASY, dealerId, greasy, 0);
+    for (int seat = 0; seat < numPlayers; seat++) {
+        PackedCard card = fastDraw(fast);
+        fast->handSlots[0][seat] = card;
+        for (int s = 1; s < handSize; s++) {
+            fast->handSlots[s][seat] = 0;
+        }
+        fast->handSizes[seat] = 1;
+        fastEmit(fast, EVENT_DEAL, seat + 1, card, 0);
+    }
+
+    // Turns pass round-robin until someone holds a card matching the greasy card.
+    // Until the hands are full every turn of a lap draws, and the draws come off the top in
+    // turn order; discards go in at the bottom, so while the deck holds a card for every seat
+    // they cannot reach one of the lap's draws. Such a lap is drawn into the next hand column
+    // up front and the whole table is checked with one matchGreasyHands call.
+    int lap = 0;
+    int lapTurn = 0;
+    bool lapDrawn = false;
+    for (;;) {
+        int seat = currentPlayer - 1;
+        Rng *rng = &fast->playerRngs[seat];
+        fast->turns++;
+
+        if (lapTurn == 0 && lap < handSize - 1 && fast->deckSize >= numPlayers) {
+            for (int k = 0; k < numPlayers; k++) {
+                int s = seat + k < numPlayers ? seat + k : seat + k - numPlayers;
+                fast->handSlots[lap + 1][s] = fastDraw(fast);
+            }
+            matchGreasyHands(fast->handSlots, handSize, fast->greasyValues, fast->greasyMatches, (size_t)numPlayers);
+            lapDrawn = true;
+        }
+
+        bool hasGreasyCard = false;
+        if (lapDrawn) {
+            PackedCard card = fast->handSlots[fast->handSizes[seat]++][seat];
+            fastEmit(fast, EVENT_DRAW, currentPlayer, card, 0);
+            hasGreasyCard = fast->greasyMatches[seat] != 0;
+        } else {
+            if (fast->handSizes[seat] < handSize) {
+                PackedCard card = fastDraw(fast);
+                fast->handSlots[fast->handSizes[seat]++][seat] = card;
+                fastEmit(fast, EVENT_DRAW, currentPlayer, card, 0);
+            }
+            for (int s = 0; s < handSize; s++) {
+                hasGreasyCard |= CARD_VALUE(fast->handSlots[s][seat]) == greasyValue;
+            }
+        }
+
+        if (hasGreasyCard) {
+            fastEmit(fast, EVENT_HOLDS_GREASY, currentPlayer, 0, 0);
+            fast->roundsWon[seat]++;
+            result->winner = (uint32_t)currentPlayer;
+            fastEmit(fast, EVENT_ROUND_WON, currentPlayer, 0, (uint32_t)round);
+        } else if (fast->handSizes[seat] == handSize) {
+            // Discard by the variant's policy, back to the bottom of the deck
+            int index = 0;
+            if (discardPolicy == DISCARD_RANDOM) {
+                index = (int)rngBelow(rng, (uint32_t)handSize);
+            } else if (discardPolicy == DISCARD_HIGHEST) {
+                for (int s = 1; s < handSize; s++) {
+                    if (CARD_VALUE(fast->handSlots[s][seat]) > CARD_VALUE(fast->handSlots[index][seat])) {
+                        index = s;
+                    }
+                }
+            }
+            PackedCard card = fast->handSlots[index][seat];
+            for (int s = index; s < handSize - 1; s++) {
+                fast->handSlots[s][seat] = fast->handSlots[s + 1][seat];
+            }
+            fast->handSlots[handSize - 1][seat] = 0;
+            fast->handSizes[seat]--;
+            fastEmit(fast, EVENT_DISCARD, currentPlayer, card, (uint32_t)index);
+            fast->deckBottom = (fast->deckBottom - 1) & fast->deckMask;
+            deck[fast->deckBottom] = card;
+            fast->deckSize++;
+
+            // Eat chips, drawing the amount before any new bag is opened as eatChips does
+            int chips = (int)rngBelow(rng, 5) + 1;
+            if (chipsInBag <= 0) {
+                chipsInBag = fast->numChips;
+                fast->bagsUsed++;
+                fastEmit(fast, EVENT_BAG_OPENED, 0, 0, (uint32_t)chipsInBag);
+            }
+            if (chips > chipsInBag) {
+                chips = chipsInBag;
+            }
+            chipsInBag -= chips;
+            fast->chipsEaten += chips;
+            fastEmit(fast, EVENT_CHIPS_EATEN, currentPlayer, 0, (uint32_t)chips);
+        }
+
+        currentPlayer = (currentPlayer % numPlayers) + 1;
+        if (hasGreasyCard) {
+            break;
+        }
+        if (++lapTurn == numPlayers) {
+            lapTurn = 0;
+            lap++;
+            lapDrawn = false;
+        }
+    }
+
+    fastEmit(fast, EVENT_ROUND_END, dealerId, 0, 0);
+    result->turns = (uint32_t)(fast->turns - turnsBefore);
+    result->chipsEaten = (uint32_t)(fast->chipsEaten - chipsBefore);
+    result->bagsUsed = (uint32_t)(fast->bagsUsed - fast->bagsBefore);
+    fast->bagsBefore = fast->bagsUsed;
+    fast->chipsInBag = chipsInBag;
+    fast->currentPlayer = currentPlayer;
+    fast->dealerId = (dealerId % numPlayers) + 1;
+    fast->rounds++;
+    if (fast->rounds == numPlayers) {
+        fastEmit(fast, EVENT_GAME_END, 0, 0, (uint32_t)numPlayers);
+    }
+}
+
+static ALWAYS_INLINE void fastPlayRules(FastGame *fast, uint64_t seed, const int handSize, const int discardPolicy) {
+    fastStartGame(fast, seed);
+    for (int round = 1; round <= fast->numPlayers; round++) {
+        fastPlayRound(fast, handSize, discardPolicy);
+    }
+}
+
+int runConformance(uint64_t seed, int numPlayers, int numChips, long long numGames) {
+    // The threaded engine keeps each game's events in its buffer: the sink has no file
+    EventSink capture = {0};
+    pthread_mutex_init(&capture.mutex, NULL);
+    GameState *game = allocateGame(numPlayers);
+    initializeGame(game, numPlayers, numChips, seed, NULL, 0);
+    game->events = &capture;
+
+    FastGame fast;
+    if (!fastGameInit(&fast, numPlayers, numChips, &ruleVariants[0], true)) {
+        perror("Error allocating the fast engine");
+        return 1;
+    }
+
+    // Play every game on both engines and compare the event streams record for record
+    long long mismatches = 0, events = 0;
+    startPlayerThreads(game);
+    for (long long g = 0; g < numGames; g++) {
+        uint64_t s = gameSeed(seed, g);
+        game->eventCount = 0;
+        resetGame(game, s);
+        playThreadedGame(game);
+        fastPlayGame(&fast, s);
+        events += (long long)fast.eventCount;
+
+        size_t common = game->eventCount < fast.eventCount ? game->eventCount : fast.eventCount;
+        size_t first = 0;
+        while (first < common && memcmp(&game->eventBuffer[first], &fast.events[first], sizeof(GameEvent)) == 0) {
+            first++;
+        }
+        if (first < common || game->eventCount != fast.eventCount) {
+            if (++mismatches <= 5) {
+                printf("Game %lld (seed %llu): streams differ at event %zu of %zu/%zu", g, (unsigned long long)s,
+                       first, game->eventCount, fast.eventCount);
+                if (first < common) {
+                    printf(" (threaded type %d player %d, fast type %d player %d)", game->eventBuffer[first].type,
+                           game->eventBuffer[first].player, fast.events[first].type, fast.events[first].player);
+                }
+                printf("\n");
+            }
+        }
+    }
+    stopPlayerThreads(game);
+
+    printf("Conformance: %lld games, %d players, %lld events compared, %lld mismatching games\n",
+           numGames, numPlayers, events, mismatches);
+
+    fastGameFree(&fast);
+    cleanup(game);
+    free(game);
+    pthread_mutex_destroy(&capture.mutex);
+    return mismatches ? 1 : 0;
+}
+
+uint64_t gameSeed(uint64_t seed, long long gameIndex) {
+    // Mix the base seed with the game index so neighbouring games get unrelated decks
+    uint64_t state = seed ^ ((uint64_t)gameIndex * 0x9E3779B97F4A7C15ULL);
+    return splitMix64(&state);
+}
+
+double elapsedSeconds(const struct timespec *start) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void* batchWorker(void *arg) {
+    BatchWorker *worker = (BatchWorker*)arg;
+    BatchConfig *config = worker->config;
+
+    // Every worker owns a fast engine; turns are sequential, so no threads per player are needed
+    FastGame fast;
+    if (!fastGameInit(&fast, config->numPlayers, config->numChips, config->rules, config->events != NULL)) {
+        perror("Error allocating the fast engine");
+        exit(EXIT_FAILURE);
+    }
+
+    BatchTotals local = {0};
+    local.seatWins = calloc((size_t)config->numPlayers, sizeof(long long));
+    if (!local.seatWins) {
+        perror("Error allocating batch totals");
+        exit(EXIT_FAILURE);
+    }
+
+    // A resumed worker picks up at its last checkpoint with the totals it had then
+    long long first = worker->workerId;
+    struct timespec lastCheckpoint;
+    EventBuffer held = {0};
+    if (config->snapshot) {
+        first = loadCheckpoint(config->snapshot, worker->workerId, &local);
+        timespec_get(&lastCheckpoint, TIME_UTC);
+    }
+
+    // Games are striped across workers; each game's seed depends only on its index
+    for (long long g = first; g < config->numGames; g += config->numWorkers) {
+        // Checkpoints fall between games, so nothing of a half-played game has to be saved
+        if (config->snapshot &&
+            elapsedSeconds(&lastCheckpoint) * 1000.0 >= config->snapshot->header->checkpointMs) {
+            commitCheckpoint(config, worker->workerId, g, &local, &held);
+            timespec_get(&lastCheckpoint, TIME_UTC);
+        }
+
+        fastPlayGame(&fast, gameSeed(config->seed, g));
+        if (config->events && config->snapshot) {
+            // Held back until the checkpoint that covers this game, so a resume never writes it twice
+            if (held.count + fast.eventCount > held.capacity) {
+                size_t capacity = held.capacity ? held.capacity : 1024;
+                while (capacity < held.count + fast.eventCount) {
+                    capacity *= 2;
+                }
+                GameEvent *events = realloc(held.events, capacity * sizeof(GameEvent));
+                if (!events) {
+                    perror("Error growing the event buffer");
+                    exit(EXIT_FAILURE);
+                }
+                held.events = events;
+                held.capacity = capacity;
+            }
+            memcpy(held.events + held.count, fast.events, fast.eventCount * sizeof(GameEvent));
+            held.count += fast.eventCount;
+            held.games++;
+        } else if (config->events) {
+            appendEvents(config->events, fast.events, fast.eventCount, 1);
+        }
+        if (config->results) {
+            appendRoundResults(config->results, worker->workerId, g, fast.roundResults, fast.rounds);
+        }
+
+        local.games++;
+        local.rounds += fast.rounds;
+        local.turns += fast.turns;
+        local.chipsEaten += fast.chipsEaten;
+        local.bagsOpened += fast.bagsUsed;
+        for (int i = 0; i < config->numPlayers; i++) {
+            local.seatWins[i] += fast.roundsWon[i];
+        }
+    }
+    if (config->snapshot) {
+        commitCheckpoint(config, worker->workerId, config->numGames, &local, &held);
+    }
+    free(held.events);
+
+    // Merge the worker's totals once at the end
+    pthread_mutex_lock(&config->totals_mutex);
+    config->totals.games += local.games;
+    config->totals.rounds += local.rounds;
+    config->totals.chipsEaten += local.chipsEaten;
+    config->totals.bagsOpened += local.bagsOpened;
+    config->totals.turns += local.turns;
+    for (int i = 0; i < config->numPlayers; i++) {
+        config->totals.seatWins[i] += local.seatWins[i];
+    }
+    pthread_mutex_unlock(&config->totals_mutex);
+
+    free(local.seatWins);
+    fastGameFree(&fast);
+    return NULL;
+}
+
+int runBatch(uint64_t seed, int numPlayers, int numChips, long long numGames, int numWorkers,
+             const RuleVariant *rules, const char *eventsPath, const char *resultsPath, Snapshot *snapshot) {
+    BatchConfig config = {0};
+    config.snapshot = snapshot;
+    config.rules = rules;
+
+    // A resumed batch carries on with the outputs as its last checkpoints left them;
+    // a fresh snapshot has no checkpoints, so its outputs start empty like any batch
+    uint64_t eventsBytes = 0, resultsBytes = 0;
+    if (snapshot) {
+        committedOutput(snapshot, &eventsBytes, &resultsBytes);
+    }
+    if (eventsPath) {
+        config.events = eventsBytes ? reopenEventSink(eventsPath, eventsBytes) : openEventSink(eventsPath);
+        if (!config.events) {
+            perror("Error opening the event stream");
+            return 1;
+        }
+    }
+    if (resultsPath) {
+        config.results = resultsBytes ? reopenResultSink(resultsPath, numWorkers, resultsBytes)
+                                      : openResultSink(resultsPath, numWorkers);
+        if (!config.results) {
+            perror("Error opening the result file");
+            return 1;
+        }
+        config.results->holdChunks = snapshot != NULL;
+    }
+    config.seed = seed;
+    config.numPlayers = numPlayers;
+    config.numChips = numChips;
+    config.numGames = numGames;
+    config.numWorkers = numWorkers;
+    config.totals.seatWins = calloc((size_t)numPlayers, sizeof(long long));
+    BatchWorker *workers = calloc((size_t)numWorkers, sizeof(BatchWorker));
+    if (!config.totals.seatWins || !workers) {
+        perror("Error allocating batch state");
+        return 1;
+    }
+    pthread_mutex_init(&config.totals_mutex, NULL);
+    pthread_mutex_init(&config.commit_mutex, NULL);
+
+    struct timespec start;
+    timespec_get(&start, TIME_UTC);
+
+    // Start one worker per requested thread
+    int started = 0;
+    for (int i = 0; i < numWorkers; i++) {
+        workers[i].config = &config;
+        workers[i].workerId = i;
+        if (pthread_create(&workers[i].thread, NULL, batchWorker, &workers[i]) != 0) {
+            perror("Failed to create the batch worker thread");
+            break;
+        }
+        started++;
+    }
+
+    // Wait for all the workers to finish their share of the games
+    for (int i = 0; i < started; i++) {
+        if (pthread_join(workers[i].thread, NULL) != 0) {
+            perror("Failed to join the batch worker thread");
+        }
+    }
+    double seconds = elapsedSeconds(&start);
+
+    int status = (started == numWorkers) ? 0 : 1;
+    if (status == 0 && snapshot) {
+        // Only a run where every worker finished may mark the snapshot complete
+        atomic_store(&snapshot->header->complete, 1);
+    }
+    if (status == 0) {
+        printf("Batch: %lld games, %d players, %d chips per bag, %d workers, seed %llu\n",
+               config.totals.games, numPlayers, numChips, numWorkers, (unsigned long long)seed);
+        printBatchTotals(&config.totals, numPlayers);
+        printf("Elapsed: %.3f s (%.0f turns/s, %.0f games/s)\n", seconds,
+               seconds > 0 ? (double)config.totals.turns / seconds : 0.0,
+               seconds > 0 ? (double)config.totals.games / seconds : 0.0);
+    }
+
+    if (config.events) {
+        printf("Events: %lld games, %lld records written to %s\n",
+               config.events->gamesWritten, config.events->eventsWritten, eventsPath);
+        closeEventSink(config.events);
+    }
+    if (config.results) {
+        // The workers have stopped, so their last partial chunks and the footer go out from here
+        if (closeResultSink(config.results)) {
+            printf("Results: %lld rounds in %lld chunks written to %s\n",
+                   config.results->rowsWritten, config.results->chunksWritten, resultsPath);
+        } else {
+            status = 1;
+        }
+        free(config.results);
+    }
+    pthread_mutex_destroy(&config.totals_mutex);
+    pthread_mutex_destroy(&config.commit_mutex);
+    free(config.totals.seatWins);
+    free(workers);
+    return status;
+}
+
+size_t snapshotSize(int numPlayers, int numWorkers, size_t *copySize, size_t *recordStride) {
+    // Record: publish counter on its own line, then two copies, padded to a whole cache line
+    size_t copy = sizeof(WorkerCheckpoint) + (size_t)numPlayers * sizeof(int64_t);
+    size_t stride = SNAPSHOT_ALIGN + 2 * copy;
+    stride = (stride + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+    if (copySize) {
+        *copySize = copy;
+    }
+    if (recordStride) {
+        *recordStride = stride;
+    }
+    return SNAPSHOT_HEADER_BYTES + (size_t)numWorkers * stride;
+}
+
+#ifndef _WIN32
+Snapshot* mapSnapshot(int fd, size_t size, int numPlayers, int numWorkers) {
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (base == MAP_FAILED) {
+        perror("Error mapping the snapshot file");
+        return NULL;
+    }
+    Snapshot *snapshot = calloc(1, sizeof(Snapshot));
+    if (!snapshot) {
+        munmap(base, size);
+        return NULL;
+    }
+    snapshot->base = base;
+    snapshot->size = size;
+    snapshotSize(numPlayers, numWorkers, &snapshot->copySize, &snapshot->recordStride);
+    snapshot->header = (SnapshotHeader*)base;
+    return snapshot;
+}
+
+Snapshot* createSnapshot(const char *path, uint64_t seed, int numPlayers, int numChips, long long numGames,
+                         int numWorkers, int checkpointMs, const RuleVariant *rules,
+                         const char *eventsPath, const char *resultsPath) {
+    // Everything a resume needs is recorded, so refuse what the header cannot hold
+    if ((eventsPath && strlen(eventsPath) >= SNAPSHOT_PATH_BYTES) ||
+        (resultsPath && strlen(resultsPath) >= SNAPSHOT_PATH_BYTES)) {
+        fprintf(stderr, "Output paths for a checkpointed batch must be shorter than %d bytes\n", SNAPSHOT_PATH_BYTES);
+        return NULL;
+    }
+    size_t size = snapshotSize(numPlayers, numWorkers, NULL, NULL);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Error creating the snapshot file");
+        return NULL;
+    }
+    // A fresh file reads as zeros, which is every worker with no checkpoint published
+    if (ftruncate(fd, (off_t)size) != 0) {
+        perror("Error sizing the snapshot file");
+        close(fd);
+        return NULL;
+    }
+    Snapshot *snapshot = mapSnapshot(fd, size, numPlayers, numWorkers);
+    if (!snapshot) {
+        return NULL;
+    }
+
+    SnapshotHeader *header = snapshot->header;
+    header->seed = seed;
+    header->numGames = numGames;
+    header->numPlayers = numPlayers;
+    header->numChips = numChips;
+    header->numWorkers = numWorkers;
+    header->checkpointMs = checkpointMs;
+    strcpy(header->rules, rules->name);
+    strcpy(header->eventsPath, eventsPath ? eventsPath : "");
+    strcpy(header->resultsPath, resultsPath ? resultsPath : "");
+    header->version = SNAPSHOT_VERSION;
+    // The magic goes in last, so a header that was never finished is not resumed
+    header->magic = SNAPSHOT_MAGIC;
+    msync(snapshot->base, snapshot->size, MS_SYNC);
+    return snapshot;
+}
+
+Snapshot* openSnapshot(const char *path) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        perror("Error opening the snapshot file");
+        return NULL;
+    }
+
+    // Check the header before trusting any size derived from it
+    SnapshotHeader header;
+    struct stat info;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Snapshot file is too short to hold a header\n");
+        close(fd);
+        return NULL;
+    }
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION) {
+        fprintf(stderr, "Not a batch snapshot, or one written by another version\n");
+        close(fd);
+        return NULL;
+    }
+    if (header.numPlayers < 1 || header.numChips < 1 || header.numGames < 1 || header.numWorkers < 1 ||
+        header.checkpointMs < 0 ||
+        (size_t)info.st_size != snapshotSize(header.numPlayers, header.numWorkers, NULL, NULL)) {
+        fprintf(stderr, "Snapshot header does not match the file size\n");
+        close(fd);
+        return NULL;
+    }
+    if (!memchr(header.rules, 0, sizeof(header.rules)) || !memchr(header.eventsPath, 0, sizeof(header.eventsPath)) ||
+        !memchr(header.resultsPath, 0, sizeof(header.resultsPath))) {
+        fprintf(stderr, "Snapshot header has an unterminated rule name or output path\n");
+        close(fd);
+        return NULL;
+    }
+    return mapSnapshot(fd, (size_t)info.st_size, header.numPlayers, header.numWorkers);
+}
+
+void closeSnapshot(Snapshot *snapshot) {
+    msync(snapshot->base, snapshot->size, MS_SYNC);
+    munmap(snapshot->base, snapshot->size);
+    free(snapshot);
+}
+
+EventSink* reopenEventSink(const char *path, uint64_t committedBytes) {
+    // Whatever follows the committed length belongs to games no checkpoint covers; they are played again
+    int fd = open(path, O_RDWR);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    GameEvent magic;
+    if ((uint64_t)info.st_size < committedBytes || committedBytes % sizeof(GameEvent) != 0 ||
+        pread(fd, &magic, sizeof(magic), 0) != (ssize_t)sizeof(magic) || magic.type != EVENT_MAGIC ||
+        magic.card != EVENT_FORMAT_VERSION || magic.value != EVENT_MAGIC_VALUE) {
+        fprintf(stderr, "%s is not the event stream this snapshot was writing\n", path);
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    EventSink *sink = calloc(1, sizeof(EventSink));
+    if (!sink || ftruncate(fd, (off_t)committedBytes) != 0 || lseek(fd, 0, SEEK_END) < 0 ||
+        !(sink->file = fdopen(fd, "ab"))) {
+        free(sink);
+        close(fd);
+        return NULL;
+    }
+    pthread_mutex_init(&sink->mutex, NULL);
+    sink->fileBytes = committedBytes;
+    return sink;
+}
+#else
+Snapshot* mapSnapshot(int fd, size_t size, int numPlayers, int numWorkers) {
+    (void)fd; (void)size; (void)numPlayers; (void)numWorkers;
+    return NULL;
+}
+
+Snapshot* createSnapshot(const char *path, uint64_t seed, int numPlayers, int numChips, long long numGames,
+                         int numWorkers, int checkpointMs, const RuleVariant *rules,
+                         const char *eventsPath, const char *resultsPath) {
+    (void)path; (void)seed; (void)numPlayers; (void)numChips; (void)numGames; (void)numWorkers; (void)checkpointMs;
+    (void)rules; (void)eventsPath; (void)resultsPath;
+    fprintf(stderr, "Batch snapshots need mmap and are not supported on this platform\n");
+    return NULL;
+}
+
+Snapshot* openSnapshot(const char *path) {
+    return createSnapshot(path, 0, 0, 0, 0, 0, 0, NULL, NULL, NULL);
+}
+
+void closeSnapshot(Snapshot *snapshot) {
+    free(snapshot);
+}
+
+EventSink* reopenEventSink(const char *path, uint64_t committedBytes) {
+    (void)path; (void)committedBytes;
+    return NULL;
+}
+#endif
+
+unsigned char* snapshotRecord(Snapshot *snapshot, int workerId) {
+    return snapshot->base + SNAPSHOT_HEADER_BYTES + (size_t)workerId * snapshot->recordStride;
+}
+
+long long loadCheckpoint(Snapshot *snapshot, int workerId, BatchTotals *totals) {
+    unsigned char *record = snapshotRecord(snapshot, workerId);
+    uint64_t published = atomic_load_explicit((_Atomic uint64_t*)record, memory_order_acquire);
+    if (published == 0) {
+        return workerId; // No checkpoint yet: start from the worker's first game
+    }
+
+    const WorkerCheckpoint *copy =
+        (const WorkerCheckpoint*)(record + SNAPSHOT_ALIGN + ((published - 1) & 1) * snapshot->copySize);
+    totals->games = copy->games;
+    totals->rounds = copy->rounds;
+    totals->chipsEaten = copy->chipsEaten;
+    totals->bagsOpened = copy->bagsOpened;
+    totals->turns = copy->turns;
+    for (int i = 0; i < snapshot->header->numPlayers; i++) {
+        totals->seatWins[i] = copy->seatWins[i];
+    }
+    return copy->nextGame;
+}
+
+void committedOutput(Snapshot *snapshot, uint64_t *eventsBytes, uint64_t *resultsBytes) {
+    // Checkpoints commit their output in turn, so the longest lengths published cover every one of them
+    *eventsBytes = 0;
+    *resultsBytes = 0;
+    for (int w = 0; w < snapshot->header->numWorkers; w++) {
+        unsigned char *record = snapshotRecord(snapshot, w);
+        uint64_t published = atomic_load_explicit((_Atomic uint64_t*)record, memory_order_acquire);
+        if (published == 0) {
+            continue;
+        }
+        const WorkerCheckpoint *copy =
+            (const WorkerCheckpoint*)(record + SNAPSHOT_ALIGN + ((published - 1) & 1) * snapshot->copySize);
+        if ((uint64_t)copy->eventsBytes > *eventsBytes) {
+            *eventsBytes = (uint64_t)copy->eventsBytes;
+        }
+        if ((uint64_t)copy->resultsBytes > *resultsBytes) {
+            *resultsBytes = (uint64_t)copy->resultsBytes;
+        }
+    }
+}
+
+void commitCheckpoint(BatchConfig *config, int workerId, long long nextGame, const BatchTotals *totals, EventBuffer *held) {
+    // Write what the worker has held back since its last checkpoint, then publish the checkpoint with the
+    // output lengths that include it. One worker at a time, so no other worker's output can sit
+    // between a published length and the output it covers.
+    pthread_mutex_lock(&config->commit_mutex);
+    uint64_t eventsBytes = 0, resultsBytes = 0;
+    if (config->events) {
+        if (held->count > 0) {
+            appendEvents(config->events, held->events, held->count, held->games);
+            held->count = 0;
+            held->games = 0;
+        }
+        if (fflush(config->events->file) != 0) {
+            perror("Error writing game events");
+        }
+        eventsBytes = config->events->fileBytes;
+    }
+    if (config->results) {
+        commitResultChunks(config->results, &config->results->writers[workerId]);
+        resultsBytes = atomic_load(&config->results->fileEnd);
+    }
+    saveCheckpoint(config->snapshot, workerId, nextGame, totals, eventsBytes, resultsBytes);
+    pthread_mutex_unlock(&config->commit_mutex);
+}
+
+void saveCheckpoint(Snapshot *snapshot, int workerId, long long nextGame, const BatchTotals *totals,
+                    uint64_t eventsBytes, uint64_t resultsBytes) {
+    unsigned char *record = snapshotRecord(snapshot, workerId);
+    _Atomic uint64_t *counter = (_Atomic uint64_t*)record;
+    uint64_t published = atomic_load_explicit(counter, memory_order_relaxed);
+
+    // Fill the copy that is not current, then publish it by bumping the counter
+    WorkerCheckpoint *copy = (WorkerCheckpoint*)(record + SNAPSHOT_ALIGN + (published & 1) * snapshot->copySize);
+    copy->nextGame = nextGame;
+    copy->eventsBytes = (int64_t)eventsBytes;
+    copy->resultsBytes = (int64_t)resultsBytes;
+    copy->games = totals->games;
+    copy->rounds = totals->rounds;
+    copy->chipsEaten = totals->chipsEaten;
+    copy->bagsOpened = totals->bagsOpened;
+    copy->turns = totals->turns;
+    for (int i = 0; i < snapshot->header->numPlayers; i++) {
+        copy->seatWins[i] = totals->seatWins[i];
+    }
+    atomic_store_explicit(counter, published + 1, memory_order_release);
+    // No msync here: the page cache keeps the data if the process dies, and
+    // closeSnapshot flushes it to disk once the run ends
+}
+
+int runResume(const char *path) {
+    Snapshot *snapshot = openSnapshot(path);
+    if (!snapshot) {
+        return 1;
+    }
+    const SnapshotHeader *header = snapshot->header;
+    const RuleVariant *rules = findRuleVariant(header->rules);
+    if (!rules) {
+        fprintf(stderr, "Snapshot was taken with rule variant %s, which this build does not have\n", header->rules);
+        closeSnapshot(snapshot);
+        return 1;
+    }
+    const char *eventsPath = header->eventsPath[0] ? header->eventsPath : NULL;
+    const char *resultsPath = header->resultsPath[0] ? header->resultsPath : NULL;
+    printf("Resuming %s rules, events to %s, results to %s\n", rules->name,
+           eventsPath ? eventsPath : "none", resultsPath ? resultsPath : "none");
+    if (atomic_load(&snapshot->header->complete)) {
+        printf("Snapshot is complete; reporting its totals\n");
+    }
+    // The workers read their own checkpoints, so resuming is the same batch run again
+    int status = runBatch(header->seed, header->numPlayers, header->numChips, header->numGames,
+                          header->numWorkers, rules, eventsPath, resultsPath, snapshot);
+    closeSnapshot(snapshot);
+    return status;
+}
+
+size_t resultColumnWidth(int column) {
+    static const size_t widths[RESULT_COLUMNS] = { 8, 4, 4, 4, 4, 4, 4, 1 };
+    return widths[column];
+}
+
+size_t resultColumnOffset(int column, size_t rows) {
+    // Offset from the chunk header; passing RESULT_COLUMNS gives the chunk size before padding
+    size_t offset = sizeof(ResultChunkHeader);
+    for (int c = 0; c < column; c++) {
+        offset += resultColumnWidth(c) * rows;
+    }
+    return offset;
+}
+
+void appendRoundResults(ResultSink *sink, int writerId, long long gameId, const RoundResult rounds[], int count) {
+    ResultWriter *writer = &sink->writers[writerId];
+    unsigned char *chunk = writer->chunk;
+    for (int i = 0; i < count; i++) {
+        size_t row = writer->rows;
+        ((uint64_t*)(chunk + resultColumnOffset(RESULT_GAME, RESULT_CHUNK_ROWS)))[row] = (uint64_t)gameId;
+        ((uint32_t*)(chunk + resultColumnOffset(RESULT_ROUND, RESULT_CHUNK_ROWS)))[row] = (uint32_t)i + 1;
+        ((uint32_t*)(chunk + resultColumnOffset(RESULT_DEALER, RESULT_CHUNK_ROWS)))[row] = rounds[i].dealer;
+        ((uint32_t*)(chunk + resultColumnOffset(RESULT_WINNER, RESULT_CHUNK_ROWS)))[row] = rounds[i].winner;
+        ((uint32_t*)(chunk + resultColumnOffset(RESULT_TURNS, RESULT_CHUNK_ROWS)))[row] = rounds[i].turns;
+        ((uint32_t*)(chunk + resultColumnOffset(RESULT_CHIPS_EATEN, RESULT_CHUNK_ROWS)))[row] = rounds[i].chipsEaten;
+        ((uint32_t*)(chunk + resultColumnOffset(RESULT_BAGS_USED, RESULT_CHUNK_ROWS)))[row] = rounds[i].bagsUsed;
+        (chunk + resultColumnOffset(RESULT_GREASY, RESULT_CHUNK_ROWS))[row] = rounds[i].greasyValue;
+        if (++writer->rows == RESULT_CHUNK_ROWS) {
+            flushResultChunk(sink, writer);
+        }
+    }
+}
+
+#ifndef _WIN32
+bool writeAllAt(int fd, const void *data, size_t size, uint64_t offset) {
+    const unsigned char *bytes = data;
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, (off_t)offset);
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= (size_t)written;
+        offset += (uint64_t)written;
+    }
+    return true;
+}
+
+bool flushResultChunk(ResultSink *sink, ResultWriter *writer) {
+    size_t rows = writer->rows;
+    if (rows == 0) {
+        return true;
+    }
+
+    // A short chunk packs its columns together; moving them front to back never overwrites one not yet moved
+    if (rows < RESULT_CHUNK_ROWS) {
+        for (int c = 1; c < RESULT_COLUMNS; c++) {
+            memmove(writer->chunk + resultColumnOffset(c, rows), writer->chunk + resultColumnOffset(c, RESULT_CHUNK_ROWS),
+                    resultColumnWidth(c) * rows);
+        }
+    }
+    ResultChunkHeader header = { RESULT_CHUNK_MAGIC, (uint32_t)rows };
+    memcpy(writer->chunk, &header, sizeof(header));
+    size_t bytes = resultChunkBytes(rows);
+    writer->rows = 0;
+
+    // A checkpointed batch keeps the chunk until the checkpoint that covers its games
+    if (sink->holdChunks) {
+        if (writer->heldBytes + bytes > writer->heldCapacity) {
+            size_t capacity = writer->heldCapacity ? writer->heldCapacity * 2 : bytes * 2;
+            unsigned char *held = realloc(writer->held, capacity);
+            if (!held) {
+                perror("Error growing the held result chunks");
+                return false;
+            }
+            writer->held = held;
+            writer->heldCapacity = capacity;
+        }
+        memcpy(writer->held + writer->heldBytes, writer->chunk, bytes);
+        writer->heldBytes += bytes;
+        return true;
+    }
+
+    // Claim the chunk's place in the file, then write it there without holding anything
+    uint64_t offset = atomic_fetch_add(&sink->fileEnd, (uint64_t)bytes);
+    if (!writeAllAt(sink->fd, writer->chunk, bytes, offset)) {
+        perror("Error writing a result chunk");
+        return false;
+    }
+    return addResultChunk(writer, offset, rows);
+}
+
+size_t resultChunkBytes(size_t rows) {
+    // Chunks are padded so the next one starts 8-byte aligned
+    return (resultColumnOffset(RESULT_COLUMNS, rows) + 7) & ~(size_t)7;
+}
+
+bool addResultChunk(ResultWriter *writer, uint64_t offset, uint64_t rows) {
+    if (writer->chunkCount == writer->chunkCapacity) {
+        size_t capacity = writer->chunkCapacity ? writer->chunkCapacity * 2 : 64;
+        ResultChunkEntry *chunks = realloc(writer->chunks, capacity * sizeof(ResultChunkEntry));
+        if (!chunks) {
+            perror("Error growing the result index");
+            return false;
+        }
+        writer->chunks = chunks;
+        writer->chunkCapacity = capacity;
+    }
+    writer->chunks[writer->chunkCount].offset = offset;
+    writer->chunks[writer->chunkCount].rows = rows;
+    writer->chunkCount++;
+    return true;
+}
+
+bool commitResultChunks(ResultSink *sink, ResultWriter *writer) {
+    // The partial chunk joins the held ones, and they all go out in one write
+    if (!flushResultChunk(sink, writer)) {
+        return false;
+    }
+    if (writer->heldBytes == 0) {
+        return true;
+    }
+    uint64_t offset = atomic_fetch_add(&sink->fileEnd, (uint64_t)writer->heldBytes);
+    bool ok = writeAllAt(sink->fd, writer->held, writer->heldBytes, offset);
+    if (!ok) {
+        perror("Error writing a result chunk");
+    }
+    for (size_t pos = 0; ok && pos < writer->heldBytes;) {
+        ResultChunkHeader header;
+        memcpy(&header, writer->held + pos, sizeof(header));
+        ok = addResultChunk(writer, offset + pos, header.rows);
+        pos += resultChunkBytes(header.rows);
+    }
+    writer->heldBytes = 0;
+    return ok;
+}
+
+ResultSink* newResultSink(int fd, int numWriters) {
+    // Takes over fd, which is closed if anything fails
+    ResultSink *sink = calloc(1, sizeof(ResultSink));
+    ResultWriter *writers = calloc((size_t)numWriters, sizeof(ResultWriter));
+    bool ok = sink && writers;
+    for (int i = 0; ok && i < numWriters; i++) {
+        writers[i].chunk = calloc(1, resultColumnOffset(RESULT_COLUMNS, RESULT_CHUNK_ROWS) + 8);
+        ok &= writers[i].chunk != NULL;
+    }
+    if (!ok) {
+        for (int i = 0; writers && i < numWriters; i++) {
+            free(writers[i].chunk);
+        }
+        free(writers);
+        free(sink);
+        close(fd);
+        return NULL;
+    }
+    sink->fd = fd;
+    sink->writers = writers;
+    sink->numWriters = numWriters;
+    return sink;
+}
+
+void freeResultSink(ResultSink *sink) {
+    for (int i = 0; i < sink->numWriters; i++) {
+        free(sink->writers[i].chunk);
+        free(sink->writers[i].chunks);
+        free(sink->writers[i].held);
+    }
+    close(sink->fd);
+    free(sink->writers);
+    free(sink);
+}
+
+ResultSink* openResultSink(const char *path, int numWriters) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    ResultSink *sink = newResultSink(fd, numWriters);
+    if (!sink) {
+        return NULL;
+    }
+
+    ResultFileHeader header = { RESULT_MAGIC, RESULT_FORMAT_VERSION, RESULT_COLUMNS };
+    if (!writeAllAt(sink->fd, &header, sizeof(header), 0)) {
+        freeResultSink(sink);
+        return NULL;
+    }
+    atomic_store(&sink->fileEnd, sizeof(header));
+    return sink;
+}
+
+ResultSink* reopenResultSink(const char *path, int numWriters, uint64_t committedBytes) {
+    // Cut the file back to what the last published checkpoint covers; that drops the footer of a
+    // finished run and any chunk no checkpoint covers. The chunks before that are walked front to
+    // back, they follow each other without gaps, and indexed again for the new footer.
+    int fd = open(path, O_RDWR);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    ResultSink *sink = newResultSink(fd, numWriters);
+    if (!sink) {
+        return NULL;
+    }
+    ResultFileHeader header;
+    bool ok = (uint64_t)info.st_size >= committedBytes && committedBytes >= sizeof(header) &&
+              pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && header.magic == RESULT_MAGIC &&
+              header.version == RESULT_FORMAT_VERSION && header.columns == RESULT_COLUMNS;
+    uint64_t pos = sizeof(header);
+    while (ok && pos < committedBytes) {
+        ResultChunkHeader chunk;
+        ok = pread(fd, &chunk, sizeof(chunk), (off_t)pos) == (ssize_t)sizeof(chunk) && chunk.magic == RESULT_CHUNK_MAGIC &&
+             chunk.rows > 0 && chunk.rows <= RESULT_CHUNK_ROWS && pos + resultChunkBytes(chunk.rows) <= committedBytes;
+        if (ok) {
+            ok = addResultChunk(&sink->writers[0], pos, chunk.rows);
+            pos += resultChunkBytes(chunk.rows);
+        }
+    }
+    if (!ok || ftruncate(fd, (off_t)committedBytes) != 0) {
+        fprintf(stderr, "%s is not the result file this snapshot was writing\n", path);
+        freeResultSink(sink);
+        errno = EINVAL;
+        return NULL;
+    }
+    atomic_store(&sink->fileEnd, committedBytes);
+    return sink;
+}
+
+int compareChunkEntries(const void *a, const void *b) {
+    uint64_t left = ((const ResultChunkEntry*)a)->offset;
+    uint64_t right = ((const ResultChunkEntry*)b)->offset;
+    return (left > right) - (left < right);
+}
+
+bool closeResultSink(ResultSink *sink) {
+    // Append what every writer still buffers, then gather their chunk lists
+    bool ok = true;
+    size_t chunkCount = 0;
+    for (int i = 0; i < sink->numWriters; i++) {
+        ok &= flushResultChunk(sink, &sink->writers[i]);
+        chunkCount += sink->writers[i].chunkCount;
+    }
+    ResultChunkEntry *index = malloc((chunkCount ? chunkCount : 1) * sizeof(ResultChunkEntry));
+    size_t n = 0;
+    uint64_t rows = 0;
+    for (int i = 0; i < sink->numWriters; i++) {
+        ResultWriter *writer = &sink->writers[i];
+        for (size_t c = 0; index && c < writer->chunkCount; c++) {
+            rows += writer->chunks[c].rows;
+            index[n++] = writer->chunks[c];
+        }
+        free(writer->chunks);
+        free(writer->chunk);
+        free(writer->held);
+    }
+    free(sink->writers);
+
+    // Footer in file order, so a scan of the index reads the file front to back
+    if (index) {
+        qsort(index, n, sizeof(ResultChunkEntry), compareChunkEntries);
+        uint64_t footerOffset = atomic_load(&sink->fileEnd);
+        ResultTrailer trailer = { footerOffset, n, rows, RESULT_COLUMNS, RESULT_MAGIC };
+        ok &= writeAllAt(sink->fd, index, n * sizeof(ResultChunkEntry), footerOffset);
+        ok &= writeAllAt(sink->fd, &trailer, sizeof(trailer), footerOffset + n * sizeof(ResultChunkEntry));
+    } else {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error writing the result file\n");
+    }
+    free(index);
+    close(sink->fd);
+    sink->rowsWritten = (long long)rows;
+    sink->chunksWritten = (long long)n;
+    return ok;
+}
+
+int runResults(const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        perror("Error opening the result file");
+        return 1;
+    }
+    size_t size = (size_t)info.st_size;
+    if (size < sizeof(ResultFileHeader) + sizeof(ResultTrailer)) {
+        fprintf(stderr, "Result file is too short\n");
+        close(fd);
+        return 1;
+    }
+    const unsigned char *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("Error mapping the result file");
+        return 1;
+    }
+
+    // Everything is found from the trailer at the end of the file
+    ResultFileHeader header;
+    ResultTrailer trailer;
+    memcpy(&header, base, sizeof(header));
+    memcpy(&trailer, base + size - sizeof(trailer), sizeof(trailer));
+    if (header.magic != RESULT_MAGIC || header.version != RESULT_FORMAT_VERSION || trailer.magic != RESULT_MAGIC ||
+        header.columns != RESULT_COLUMNS || trailer.columns != RESULT_COLUMNS ||
+        trailer.footerOffset + trailer.chunkCount * sizeof(ResultChunkEntry) + sizeof(trailer) != size) {
+        fprintf(stderr, "Not a result file, an unfinished one, or one written by another version\n");
+        munmap((void*)base, size);
+        return 1;
+    }
+    const ResultChunkEntry *index = (const ResultChunkEntry*)(base + trailer.footerOffset);
+    for (uint64_t c = 0; c < trailer.chunkCount; c++) {
+        ResultChunkHeader chunk;
+        if (index[c].offset + resultColumnOffset(RESULT_COLUMNS, index[c].rows) > trailer.footerOffset) {
+            fprintf(stderr, "Chunk %llu runs past the footer\n", (unsigned long long)c);
+            munmap((void*)base, size);
+            return 1;
+        }
+        memcpy(&chunk, base + index[c].offset, sizeof(chunk));
+        if (chunk.magic != RESULT_CHUNK_MAGIC || chunk.rows != index[c].rows) {
+            fprintf(stderr, "Chunk %llu does not match the footer\n", (unsigned long long)c);
+            munmap((void*)base, size);
+            return 1;
+        }
+    }
+
+    // Seat count from the dealer column: every seat deals once per game
+    uint32_t numPlayers = 0;
+    for (uint64_t c = 0; c < trailer.chunkCount; c++) {
+        const uint32_t *dealers = (const uint32_t*)(base + index[c].offset + resultColumnOffset(RESULT_DEALER, index[c].rows));
+        for (uint64_t i = 0; i < index[c].rows; i++) {
+            if (dealers[i] > numPlayers) numPlayers = dealers[i];
+        }
+    }
+
+    // Rebuild the batch totals column by column
+    BatchTotals totals = {0};
+    totals.seatWins = calloc(numPlayers ? numPlayers : 1, sizeof(long long));
+    if (!totals.seatWins) {
+        munmap((void*)base, size);
+        return 1;
+    }
+    for (uint64_t c = 0; c < trailer.chunkCount; c++) {
+        const unsigned char *chunk = base + index[c].offset;
+        size_t rows = (size_t)index[c].rows;
+        const uint32_t *roundColumn = (const uint32_t*)(chunk + resultColumnOffset(RESULT_ROUND, rows));
+        const uint32_t *winners = (const uint32_t*)(chunk + resultColumnOffset(RESULT_WINNER, rows));
+        const uint32_t *turns = (const uint32_t*)(chunk + resultColumnOffset(RESULT_TURNS, rows));
+        const uint32_t *chips = (const uint32_t*)(chunk + resultColumnOffset(RESULT_CHIPS_EATEN, rows));
+        const uint32_t *bags = (const uint32_t*)(chunk + resultColumnOffset(RESULT_BAGS_USED, rows));
+        for (size_t i = 0; i < rows; i++) {
+            totals.games += roundColumn[i] == 1;
+            totals.turns += turns[i];
+            totals.chipsEaten += chips[i];
+            totals.bagsOpened += bags[i];
+            if (winners[i] >= 1 && winners[i] <= numPlayers) {
+                totals.seatWins[winners[i] - 1]++;
+            }
+        }
+        totals.rounds += (long long)rows;
+    }
+
+    printf("Results: %llu rounds in %llu chunks, %lld games, %u players, %.4f turns per round\n",
+           (unsigned long long)trailer.rows, (unsigned long long)trailer.chunkCount, totals.games, numPlayers,
+           totals.rounds > 0 ? (double)totals.turns / (double)totals.rounds : 0.0);
+    printBatchTotals(&totals, (int)numPlayers);
+    free(totals.seatWins);
+    munmap((void*)base, size);
+    return 0;
+}
+#else
+bool writeAllAt(int fd, const void *data, size_t size, uint64_t offset) {
+    (void)fd; (void)data; (void)size; (void)offset;
+    return false;
+}
+
+bool flushResultChunk(ResultSink *sink, ResultWriter *writer) {
+    (void)sink;
+    writer->rows = 0;
+    return false;
+}
+
+ResultSink* openResultSink(const char *path, int numWriters) {
+    (void)path; (void)numWriters;
+    fprintf(stderr, "Result files need pwrite and mmap and are not supported on this platform\n");
+    return NULL;
+}
+
+ResultSink* reopenResultSink(const char *path, int numWriters, uint64_t committedBytes) {
+    (void)committedBytes;
+    return openResultSink(path, numWriters);
+}
+
+bool commitResultChunks(ResultSink *sink, ResultWriter *writer) {
+    return flushResultChunk(sink, writer);
+}
+
+int compareChunkEntries(const void *a, const void *b) {
+    (void)a; (void)b;
+    return 0;
+}
+
+bool closeResultSink(ResultSink *sink) {
+    (void)sink;
+    return false;
+}
+
+int runResults(const char *path) {
+    return openResultSink(path, 0) ? 0 : 1;
+}
+#endif
+
+void printBatchTotals(const BatchTotals *totals, int numPlayers) {
+    long long totalRoundsWon = totals->rounds > 0 ? totals->rounds : 1;
+    double games = totals->games > 0 ? (double)totals->games : 1.0;
+
+    if (numPlayers <= MAX_PLAYERS) {
+        // Small tables: one line per seat
+        for (int i = 0; i < numPlayers; i++) {
+            printf("Seat %d: win rate %.4f%% (%lld rounds won)\n", i + 1,
+                   100.0 * (double)totals->seatWins[i] / (double)totalRoundsWon, totals->seatWins[i]);
+        }
+    } else {
+        // Large tables: only the spread between the luckiest and unluckiest seat
+        int best = 0, worst = 0;
+        for (int i = 1; i < numPlayers; i++) {
+            if (totals->seatWins[i] > totals->seatWins[best]) best = i;
+            if (totals->seatWins[i] < totals->seatWins[worst]) worst = i;
+        }
+        printf("Seat win rate: min %.4f%% (seat %d), max %.4f%% (seat %d), mean %.4f%%\n",
+               100.0 * (double)totals->seatWins[worst] / (double)totalRoundsWon, worst + 1,
+               100.0 * (double)totals->seatWins[best] / (double)totalRoundsWon, best + 1,
+               100.0 / numPlayers);
+    }
+    printf("Average rounds per game: %.4f\n", (double)totals->rounds / games);
+    printf("Average chips eaten per game: %.4f\n", (double)totals->chipsEaten / games);
+    printf("Average bags opened per game: %.4f\n", (double)totals->bagsOpened / games);
+}
+
+void pushTable(TableScheduler *sched, Table *table) {
+    // Append the table to the run queue and wake one idle worker
+    pthread_mutex_lock(&sched->queue_mutex);
+    sched->queue[(sched->head + sched->count) % sched->numTables] = table;
+    sched->count++;
+    pthread_cond_signal(&sched->queue_cond);
+    pthread_mutex_unlock(&sched->queue_mutex);
+}
+
+Table* popTable(TableScheduler *sched) {
+    pthread_mutex_lock(&sched->queue_mutex);
+    // Sleep while other workers hold every unfinished table
+    while (sched->count == 0 && sched->activeTables > 0) {
+        pthread_cond_wait(&sched->queue_cond, &sched->queue_mutex);
+    }
+
+    // NULL tells the worker that every game has finished
+    Table *table = NULL;
+    if (sched->count > 0) {
+        table = sched->queue[sched->head];
+        sched->head = (sched->head + 1) % sched->numTables;
+        sched->count--;
+    }
+    pthread_mutex_unlock(&sched->queue_mutex);
+    return table;
+}
+
+bool runTableSlice(FastGame *fast, Table *table) {
+    // Point the worker's engine at this table: streams and wins in place, the rest copied in
+    fast->playerRngs = table->playerRngs;
+    fast->roundsWon = table->roundsWon;
+    if (!table->started) {
+        fastStartGame(fast, table->seed);
+        table->started = true;
+    } else {
+        fast->rng = table->rng;
+        fast->rounds = table->rounds;
+        fast->turns = table->turns;
+        fast->chipsEaten = table->chipsEaten;
+        fast->bagsUsed = table->bagsUsed;
+        fast->bagsBefore = table->bagsBefore;
+        fast->chipsInBag = table->chipsInBag;
+        fast->currentPlayer = table->currentPlayer;
+        fast->dealerId = table->dealerId;
+    }
+
+    // Play whole rounds until the slice is used up, so one long game cannot starve the other tables
+    long long sliceEnd = fast->turns + SCHED_TURN_SLICE;
+    while (fast->rounds < fast->numPlayers && fast->turns < sliceEnd) {
+        fast->rules->playRound(fast);
+    }
+
+    table->rng = fast->rng;
+    table->rounds = fast->rounds;
+    table->turns = fast->turns;
+    table->chipsEaten = fast->chipsEaten;
+    table->bagsUsed = fast->bagsUsed;
+    table->bagsBefore = fast->bagsBefore;
+    table->chipsInBag = fast->chipsInBag;
+    table->currentPlayer = fast->currentPlayer;
+    table->dealerId = fast->dealerId;
+    return table->rounds == fast->numPlayers; // The game is over
+}
+
+void tableDone(TableScheduler *sched, Table *table) {
+    // Merge the finished table's results into the totals
+    pthread_mutex_lock(&sched->totals_mutex);
+    sched->totals.games++;
+    sched->totals.rounds += table->rounds;
+    sched->totals.chipsEaten += table->chipsEaten;
+    sched->totals.bagsOpened += table->bagsUsed;
+    for (int i = 0; i < sched->numPlayers; i++) {
+        sched->totals.seatWins[i] += table->roundsWon[i];
+    }
+    sched->totals.turns += table->turns;
+    pthread_mutex_unlock(&sched->totals_mutex);
+
+    // The table's memory is released as soon as its game ends
+    free(table->playerRngs);
+    free(table->roundsWon);
+    table->playerRngs = NULL;
+    table->roundsWon = NULL;
+
+    // When the last table finishes, wake every worker so they can exit
+    pthread_mutex_lock(&sched->queue_mutex);
+    sched->activeTables--;
+    if (sched->activeTables == 0) {
+        pthread_cond_broadcast(&sched->queue_cond);
+    }
+    pthread_mutex_unlock(&sched->queue_mutex);
+}
+
+void* tableWorker(void *arg) {
+    TableScheduler *sched = (TableScheduler*)arg;
+
+    // One engine per worker, reused for every table it picks up
+    FastGame fast;
+    if (!fastGameInit(&fast, sched->numPlayers, sched->numChips, &ruleVariants[0], false)) {
+        perror("Error allocating the fast engine");
+        exit(EXIT_FAILURE);
+    }
+    // Tables bring their own streams and wins; the engine's are put back before it is freed
+    Rng *playerRngs = fast.playerRngs;
+    int *roundsWon = fast.roundsWon;
+
+    // Take the next runnable table, play a slice of it, and put it back unless its game ended
+    Table *table;
+    while ((table = popTable(sched)) != NULL) {
+        if (runTableSlice(&fast, table)) {
+            tableDone(sched, table);
+        } else {
+            pushTable(sched, table);
+        }
+    }
+
+    fast.playerRngs = playerRngs;
+    fast.roundsWon = roundsWon;
+    fastGameFree(&fast);
+    return NULL;
+}
+
+int runTables(uint64_t seed, int numTables, int numPlayers, int numChips, int numWorkers) {
+    TableScheduler sched = {0};
+    sched.numTables = numTables;
+    sched.activeTables = numTables;
+    sched.numPlayers = numPlayers;
+    sched.numChips = numChips;
+    sched.queue = calloc((size_t)numTables, sizeof(Table*));
+    sched.totals.seatWins = calloc((size_t)numPlayers, sizeof(long long));
+    Table *tables = calloc((size_t)numTables, sizeof(Table));
+    pthread_t *workers = calloc((size_t)numWorkers, sizeof(pthread_t));
+    if (!sched.queue || !sched.totals.seatWins || !tables || !workers) {
+        perror("Error allocating table scheduler");
+        return 1;
+    }
+    pthread_mutex_init(&sched.queue_mutex, NULL);
+    pthread_cond_init(&sched.queue_cond, NULL);
+    pthread_mutex_init(&sched.totals_mutex, NULL);
+
+    struct timespec start;
+    timespec_get(&start, TIME_UTC);
+
+    // Every table plays one game, seeded like the matching game of a batch
+    for (int i = 0; i < numTables; i++) {
+        tables[i].seed = gameSeed(seed, i);
+        tables[i].playerRngs = malloc((size_t)numPlayers * sizeof(Rng));
+        tables[i].roundsWon = calloc((size_t)numPlayers, sizeof(int));
+        if (!tables[i].playerRngs || !tables[i].roundsWon) {
+            perror("Error allocating table state");
+            return 1;
+        }
+        sched.queue[i] = &tables[i];
+    }
+    sched.count = numTables;
+
+    // A fixed pool of workers multiplexes every player of every table
+    int started = 0;
+    for (int i = 0; i < numWorkers; i++) {
+        if (pthread_create(&workers[i], NULL, tableWorker, &sched) != 0) {
+            perror("Failed to create the table worker thread");
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        tableWorker(&sched); // Fall back to playing every table on this thread
+    }
+    for (int i = 0; i < started; i++) {
+        if (pthread_join(workers[i], NULL) != 0) {
+            perror("Failed to join the table worker thread");
+        }
+    }
+    double seconds = elapsedSeconds(&start);
 
-        // Log the card that was drawn for the player
-        fprintf(game->log_file, "PLAYER %d: draws %s\n",
-                game->players[i].id, cardValueStr(newCard.value));
+    printf("Tables: %d tables, %d players each, %d chips per bag, %d workers, seed %llu\n",
+           numTables, numPlayers, numChips, numWorkers, (unsigned long long)seed);
+    printBatchTotals(&sched.totals, numPlayers);
+    printf("Elapsed: %.3f s (%.0f turns/s, %.0f games/s)\n", seconds,
+           seconds > 0 ? (double)sched.totals.turns / seconds : 0.0,
+           seconds > 0 ? (double)sched.totals.games / seconds : 0.0);
+
+    pthread_mutex_destroy(&sched.queue_mutex);
+    pthread_cond_destroy(&sched.queue_cond);
+    pthread_mutex_destroy(&sched.totals_mutex);
+    free(sched.queue);
+    free(sched.totals.seatWins);
+    free(tables);
+    free(workers);
+    return 0;
+}
+
+// Turn budget shared by the handoff benchmark threads, only touched by the token holder
+static long long handoffTurnsLeft;
+
+void* handoffRoutine(void *arg) {
+    Player *player = (Player*)arg;
+    GameState *game = player->game;
+
+    // Pass the turn straight on, ending the "round" once the budget is spent
+    while (waitForTurn(game, player->id)) {
+        bool done = (--handoffTurnsLeft <= 0);
+        signalNextPlayerTurn(game, (player->id % game->numPlayers) + 1, done);
     }
+    return NULL;
+}
 
-    // Flush the log file to ensure all information is written
-    fflush(game->log_file);
+int runHandoffBenchmark(int numPlayers, long long numTurns) {
+    double seconds = timeHandoffs(numPlayers, numTurns);
+    printf("Handoff: %d players, %lld turns, %.3f s, %.1f ns per handoff\n",
+           numPlayers, numTurns, seconds, seconds * 1e9 / (double)numTurns);
+    return 0;
 }
 
-void endRound(GameState *game) {
-    // Log the end of the round with the current dealer's ID
-    fprintf(game->log_file, "Player %d: Round ends\n", game->dealerId);
-    fprintf(game->log_file, "\n"); // Adding a newline for better readability in the log
+double timeHandoffs(int numPlayers, long long numTurns) {
+    GameState *game = allocateGame(numPlayers);
+    initializeGame(game, numPlayers, 1, 1, NULL, 0);
+    resetTurns(game);
+    handoffTurnsLeft = numTurns;
 
-    // Update the dealer for the next round by cycling to the next player
-    game->dealerId = (game->dealerId % game->numPlayers) + 1;
+    struct timespec start;
+    timespec_get(&start, TIME_UTC);
 
-    // Increment the round number
-    game->round++;
+    for (int i = 0; i < numPlayers; i++) {
+        if (pthread_create(&game->players[i].thread, NULL, handoffRoutine, &game->players[i]) != 0) {
+            perror("Failed to create the handoff thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < numPlayers; i++) {
+        pthread_join(game->players[i].thread, NULL);
+    }
+    double seconds = elapsedSeconds(&start);
 
-    // Check if there are more rounds to play
-    if (game->round <= game->totalRounds) {
-        // If more rounds are left, start the next round
-        startRound(game);
-    } else {
-        // If all rounds have been played, log the game completion and perform cleanup
-        fprintf(game->log_file, "Game completed after %d rounds.\n", game->totalRounds);
-        fflush(game->log_file); // Ensure the log file is updated
-        cleanup(game); // Clean up resources used by the game
-        printf("Game has ended. Thank you for playing!\n"); // Print a message to the console
+    cleanup(game);
+    free(game);
+    return seconds;
+}
+
+void* deckBenchRoutine(void *arg) {
+    DeckBench *bench = (DeckBench*)arg;
+    Card card;
+
+    // Each operation draws the top card and puts it back at the bottom, like a discarding turn
+    for (long long i = 0; i < bench->opsPerThread; i++) {
+        switch (bench->variant) {
+        case 0:
+            pthread_mutex_lock(&bench->array.mutex);
+            card = bench->array.cards[--bench->array.size];
+            pthread_mutex_unlock(&bench->array.mutex);
+            pthread_mutex_lock(&bench->array.mutex);
+            for (int j = bench->array.size; j > 0; j--) {
+                bench->array.cards[j] = bench->array.cards[j - 1];
+            }
+            bench->array.cards[0] = card;
+            bench->array.size++;
+            pthread_mutex_unlock(&bench->array.mutex);
+            break;
+        case 1:
+            pthread_mutex_lock(&bench->ringMutex);
+            ringDraw(&bench->ring, &card);
+            pthread_mutex_unlock(&bench->ringMutex);
+            pthread_mutex_lock(&bench->ringMutex);
+            ringDiscard(&bench->ring, card);
+            pthread_mutex_unlock(&bench->ringMutex);
+            break;
+        default:
+            lockFreeDraw(&bench->lockFree, &card);
+            lockFreeDiscard(&bench->lockFree, card);
+            break;
+        }
     }
+    return NULL;
 }
-void* playerRoutine(void* arg) {
-    Player* player = (Player*)arg; // Cast the argument to a Player structure
 
-    // Continue playing until all rounds are completed
-    while (game.round <= game.totalRounds) {
-        // Wait for the player's turn
-        waitForTurn(&game, player->id);
+int runDeckBenchmark(int numThreads, long long opsPerThread) {
+    static const char* const names[] = { "array + mutex (shift)", "ring + mutex", "lock-free ring" };
+    // Leave room for every thread to hold one drawn card at a time
+    int startSize = NUM_CARDS - numThreads;
+    if (startSize < 1) {
+        fprintf(stderr, "Too many threads for a %d card deck\n", NUM_CARDS);
+        return 1;
+    }
+
+    DeckBench *bench = calloc(1, sizeof(DeckBench));
+    pthread_t *threads = calloc((size_t)numThreads, sizeof(pthread_t));
+    int capacity = ringCapacityFor(NUM_CARDS);
+    if (!bench || !threads || !ringInit(&bench->ring, capacity) || !lockFreeInit(&bench->lockFree, capacity)) {
+        perror("Error allocating deck benchmark");
+        return 1;
+    }
+    Card cards[NUM_CARDS];
+    initializeDeck(cards);
+    pthread_mutex_init(&bench->array.mutex, NULL);
+    pthread_mutex_init(&bench->ringMutex, NULL);
+    bench->opsPerThread = opsPerThread;
 
-        // Draw a card if the player has less than 2 cards
-        if (player->hand_size < HAND_SIZE) {
-            Card drawnCard = drawCard(&game);
-            player->hand[player->hand_size++] = drawnCard;
-            const char* cardStr = cardValueStr(drawnCard.value);
-            // Log the drawn card
-            fprintf(game.log_file, "PLAYER %d: draws %s\n", player->id, cardStr);
+    for (int variant = 0; variant < 3; variant++) {
+        memcpy(bench->array.cards, cards, sizeof(cards));
+        bench->array.size = startSize;
+        ringLoad(&bench->ring, cards, startSize);
+        lockFreeLoad(&bench->lockFree, cards, startSize);
+        bench->variant = variant;
+
+        struct timespec start;
+        timespec_get(&start, TIME_UTC);
+        for (int i = 0; i < numThreads; i++) {
+            if (pthread_create(&threads[i], NULL, deckBenchRoutine, bench) != 0) {
+                perror("Failed to create the deck benchmark thread");
+                exit(EXIT_FAILURE);
+            }
         }
+        for (int i = 0; i < numThreads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        double seconds = elapsedSeconds(&start);
+        double ops = (double)opsPerThread * numThreads;
 
-        // Check if player's hand contains the Greasy card
-        bool hasGreasyCard = false;
-        for (int i = 0; i < player->hand_size; i++) {
-            if (player->hand[i].value == game.greasyCard.value) {
-                hasGreasyCard = true;
+        printf("Deck %-22s %d threads, %d cards: %.1f ns per draw+discard (%.0f ops/s)\n",
+               names[variant], numThreads, startSize, seconds * 1e9 / ops, ops / seconds);
+    }
+
+    pthread_mutex_destroy(&bench->array.mutex);
+    pthread_mutex_destroy(&bench->ringMutex);
+    ringFree(&bench->ring);
+    lockFreeFree(&bench->lockFree);
+    free(threads);
+    free(bench);
+    return 0;
+}
+
+void replayError(long long *errors, long long index, const char *message, int player) {
+    // Report the first few problems in detail, then only count them
+    if (++*errors <= 10) {
+        fprintf(stderr, "Event %lld: %s (player %d)\n", index, message, player);
+    }
+}
+
+// Table-wide records (game header, shoe, new bag, game end) carry no player; every other record names a seat
+bool eventHasSeat(int type) {
+    return type >= EVENT_ROUND_START && type <= EVENT_ROUND_END && type != EVENT_SHOE && type != EVENT_BAG_OPENED;
+}
+
+void renderHand(FILE *out, int playerId, const Card hand[], int handSize) {
+    // Same layout as displayPlayerHand
+    fprintf(out, "PLAYER %d: hand ", playerId);
+    for (int i = 0; i < handSize; i++) {
+        fprintf(out, "%s%s", cardValueStr(hand[i].value), (i < handSize - 1) ? "," : "");
+    }
+    fputc('\n', out);
+}
+
+void renderDeck(FILE *out, CardRing *deck) {
+    // Same layout as logDeckContents, bottom card first
+    fputs("DECK: ", out);
+    for (int i = 0; i < deck->size; i++) {
+        fprintf(out, "%s ", cardValueStr(CARD_VALUE(deck->cards[(deck->bottom + i) & deck->mask])));
+    }
+    fputc('\n', out);
+}
+
+int runReplay(const char *path, bool renderText) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror("Error opening the event stream");
+        return 1;
+    }
+    GameEvent magic;
+    if (fread(&magic, sizeof(magic), 1, file) != 1 || magic.type != EVENT_MAGIC ||
+        magic.value != EVENT_MAGIC_VALUE || magic.card != EVENT_FORMAT_VERSION) {
+        fprintf(stderr, "%s is not a version %d event stream\n", path, EVENT_FORMAT_VERSION);
+        fclose(file);
+        return 1;
+    }
+    FILE *out = renderText ? stdout : NULL;
+
+    // Replayed table state, sized at each GAME_START
+    int numPlayers = 0, numChips = 0, shoeSize = 0, shoeFill = 0;
+    Card (*hands)[HAND_SIZE] = NULL;
+    int *handSizes = NULL;
+    Card *shoe = NULL;
+    CardRing deck = {0};
+    Card greasy = {0};
+    int round = 0, dealer = 0, nextTurn = 0, chipsInBag = 0;
+    bool inGame = false;
+    long long games = 0, rounds = 0, chipsEaten = 0, errors = 0, index = 0;
+
+    GameEvent events[4096];
+    size_t count;
+    while ((count = fread(events, sizeof(GameEvent), sizeof(events) / sizeof(events[0]), file)) > 0) {
+        for (size_t e = 0; e < count; e++, index++) {
+            const GameEvent *event = &events[e];
+            int player = event->player;
+            Card card = unpackCardByte(event->card);
+            Card top;
+
+            // Every event but the game header needs a game in progress and, for player events, a real seat
+            if (event->type != EVENT_GAME_START && !inGame) {
+                replayError(&errors, index, "event outside a game", player);
+                continue;
+            }
+            if (eventHasSeat(event->type) && (player < 1 || player > numPlayers)) {
+                replayError(&errors, index, "no such player", player);
+                continue;
+            }
+
+            switch (event->type) {
+            case EVENT_GAME_START:
+                if (inGame) {
+                    replayError(&errors, index, "game started before the previous one ended", player);
+                }
+                if (player < 1 || player > EVENT_MAX_PLAYERS || event->value < 1 || event->value > INT32_MAX) {
+                    // Nothing can be replayed against a table with no seats or no chips; skip to the next header
+                    replayError(&errors, index, "game has no players or no chips", player);
+                    inGame = false;
+                    continue;
+                }
+                // Resize the table for the new game
+                numPlayers = player;
+                numChips = (int)event->value;
+                shoeSize = shoeDecksFor(numPlayers, HAND_SIZE) * NUM_CARDS;
+                free(hands);
+                free(handSizes);
+                free(shoe);
+                ringFree(&deck);
+                hands = calloc((size_t)numPlayers, sizeof(*hands));
+                handSizes = calloc((size_t)numPlayers, sizeof(int));
+                shoe = malloc((size_t)shoeSize * sizeof(Card));
+                if (!hands || !handSizes || !shoe || !ringInit(&deck, ringCapacityFor(shoeSize))) {
+                    perror("Error allocating replay state");
+                    exit(EXIT_FAILURE);
+                }
+                round = 1;
+                dealer = 1;
+                nextTurn = 1;
+                chipsInBag = numChips;
+                inGame = true;
+                games++;
+                break;
+
+            case EVENT_ROUND_START:
+                if (player != dealer || (int)event->value != round) {
+                    replayError(&errors, index, "round started out of order", player);
+                }
+                shoeFill = 0;
+                deck.size = 0;
+                memset(handSizes, 0, (size_t)numPlayers * sizeof(int));
+                if (out) fprintf(out, "Player %d: Round starts\n", player);
+                break;
+
+            case EVENT_SHOE:
+                // Five cards per record, the shoe is loaded once the last one arrives
+                for (int j = 0; j < EVENT_SHOE_CARDS && shoeFill < shoeSize; j++) {
+                    uint8_t packed = (j == 0) ? event->card : (uint8_t)(event->value >> (8 * (j - 1)));
+                    shoe[shoeFill++] = unpackCardByte(packed);
+                }
+                if (shoeFill == shoeSize) {
+                    ringLoad(&deck, shoe, shoeSize);
+                }
+                break;
+
+            case EVENT_GREASY:
+                if (!ringDraw(&deck, &top) || top.value != card.value || top.suit != card.suit) {
+                    replayError(&errors, index, "greasy card is not the top of the deck", player);
+                }
+                greasy = card;
+                if (out) fprintf(out, "Player %d: draws Greasy card %s\n", player, cardValueStr(card.value));
+                break;
+
+            case EVENT_DEAL:
+            case EVENT_DRAW:
+                if (event->type == EVENT_DRAW && player != nextTurn) {
+                    replayError(&errors, index, "drew out of turn", player);
+                }
+                if (!ringDraw(&deck, &top) || top.value != card.value || top.suit != card.suit) {
+                    replayError(&errors, index, "drawn card is not the top of the deck", player);
+                }
+                if (handSizes[player - 1] >= HAND_SIZE) {
+                    replayError(&errors, index, "hand is already full", player);
+                } else {
+                    hands[player - 1][handSizes[player - 1]++] = card;
+                }
+                if (out) fprintf(out, "PLAYER %d: draws %s\n", player, cardValueStr(card.value));
+                break;
+
+            case EVENT_HOLDS_GREASY: {
+                bool holds = false;
+                for (int i = 0; i < handSizes[player - 1]; i++) {
+                    holds = holds || hands[player - 1][i].value == greasy.value;
+                }
+                if (!holds) {
+                    replayError(&errors, index, "does not hold the greasy card", player);
+                }
+                if (out) {
+                    renderHand(out, player, hands[player - 1], handSizes[player - 1]);
+                    fprintf(out, " <> Greasy card is %s\n", cardValueStr(greasy.value));
+                }
+                break;
+            }
+
+            case EVENT_DISCARD: {
+                Card *hand = hands[player - 1];
+                int slot = (int)event->value;
+                if (slot < 0 || slot >= handSizes[player - 1] || hand[slot].value != card.value || hand[slot].suit != card.suit) {
+                    replayError(&errors, index, "discarded a card not in hand", player);
+                } else {
+                    // Remove the card the same way playTurn does, keeping the order of the rest
+                    for (int i = slot; i < handSizes[player - 1] - 1; i++) {
+                        hand[i] = hand[i + 1];
+                    }
+                    handSizes[player - 1]--;
+                }
+                if (!ringDiscard(&deck, card)) {
+                    replayError(&errors, index, "deck overflow", player);
+                }
+                nextTurn = (player % numPlayers) + 1;
+                if (out) {
+                    fprintf(out, "PLAYER %d: discards %s at random\n", player, cardValueStr(card.value));
+                    renderHand(out, player, hand, handSizes[player - 1]);
+                    renderDeck(out, &deck);
+                }
+                break;
+            }
+
+            case EVENT_BAG_OPENED:
+                if (chipsInBag > 0 || (int)event->value != numChips) {
+                    replayError(&errors, index, "bag opened while chips were left", player);
+                }
+                chipsInBag = (int)event->value;
+                if (out) fprintf(out, "New bag of chips opened\nBAG: %d Chips left\n", chipsInBag);
+                break;
+
+            case EVENT_CHIPS_EATEN:
+                if (event->value < 1 || (int)event->value > chipsInBag) {
+                    replayError(&errors, index, "ate more chips than the bag holds", player);
+                }
+                chipsInBag -= (int)event->value;
+                chipsEaten += event->value;
+                if (out) fprintf(out, "PLAYER %d: eats %u chips\nBAG: %d Chips left\n", player, event->value, chipsInBag);
+                break;
+
+            case EVENT_ROUND_WON:
+                if ((int)event->value != round) {
+                    replayError(&errors, index, "won the wrong round", player);
+                }
+                nextTurn = (player % numPlayers) + 1;
+                if (out) {
+                    fprintf(out, "PLAYER %d: wins round %d\n", player, round);
+                    for (int i = 1; i <= numPlayers; i++) {
+                        if (i != player) {
+                            fprintf(out, "PLAYER %d: lost round %d\n", i, round);
+                        }
+                    }
+                }
+                break;
+
+            case EVENT_ROUND_END:
+                if (out) fprintf(out, "Player %d: Round ends\n\n", player);
+                dealer = (dealer % numPlayers) + 1;
+                round++;
+                rounds++;
+                break;
+
+            case EVENT_GAME_END:
+                if ((int)event->value != round - 1) {
+                    replayError(&errors, index, "game ended after the wrong number of rounds", player);
+                }
+                if (out) fprintf(out, "Game completed after %u rounds.\n", event->value);
+                inGame = false;
+                break;
+
+            default:
+                replayError(&errors, index, "unknown event type", player);
                 break;
             }
         }
+    }
+    if (inGame) {
+        replayError(&errors, index, "stream ends in the middle of a game", 0);
+    }
 
-        // Log the player's hand if it contains the Greasy card
-        if (hasGreasyCard) {
-            displayPlayerHand(game.log_file, player);
-            fprintf(game.log_file, " <> Greasy card is %s\n", cardValueStr(game.greasyCard.value));
+    // The summary goes to stderr when stdout carries the rendered log
+    fprintf(renderText ? stderr : stdout,
+            "Replay: %lld events, %lld games, %lld rounds, %lld chips eaten, %lld errors\n",
+            index, games, rounds, chipsEaten, errors);
+
+    free(hands);
+    free(handSizes);
+    free(shoe);
+    ringFree(&deck);
+    fclose(file);
+    return errors ? 1 : 0;
+}
+
+double benchNow(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Each microbenchmark below returns the seconds spent in the measured calls only;
+// refilling or emptying the deck between blocks is left out of the timing.
+
+double benchShuffle(long long iterations) {
+    Card cards[NUM_CARDS];
+    Rng rng;
+    initializeDeck(cards);
+    rngSeed(&rng, 1, 0);
+
+    double start = benchNow();
+    for (long long i = 0; i < iterations; i++) {
+        shuffleDeck(cards, NUM_CARDS, &rng);
+    }
+    return benchNow() - start;
+}
+
+double benchDraw(long long iterations) {
+    GameState *game = allocateGame(4);
+    initializeGame(game, 4, 5, 1, NULL, 0);
+
+    // Draw the deck down in blocks of 50, refilling it between blocks
+    double seconds = 0;
+    for (long long done = 0; done < iterations; done += 50) {
+        loadDeck(game, game->shoe, game->shoeSize);
+        double start = benchNow();
+        for (int i = 0; i < 50; i++) {
+            drawCard(game);
         }
+        seconds += benchNow() - start;
+    }
 
-        // Discard a card if the player doesn't have the Greasy card and hand is full
-        if (!hasGreasyCard && player->hand_size == HAND_SIZE) {
-            int randomIndex = rand() % player->hand_size;
-            Card cardToDiscard = player->hand[randomIndex];
-            // Remove the discarded card from hand
-            for (int i = randomIndex; i < player->hand_size - 1; i++) {
-                player->hand[i] = player->hand[i + 1];
-            }
-            player->hand_size--;
-            // Log the discarded card
-            fprintf(game.log_file, "PLAYER %d: discards %s at random\n", player->id, cardValueStr(cardToDiscard.value));
+    cleanup(game);
+    free(game);
+    return seconds;
+}
+
+double benchDiscard(long long iterations) {
+    GameState *game = allocateGame(4);
+    initializeGame(game, 4, 5, 1, NULL, 0);
+    Card card = game->shoe[0];
 
-            // Discard the card and update game state
-            discardCard(&game, player, cardToDiscard);
-            displayPlayerHand(game.log_file, player);
-            logDeckContents(&game);
-            eatChips(&game, player);
-        } else if (hasGreasyCard) {
-            // Declare the player as the winner if they have the Greasy card
-            declareWinner(&game, player);
-            endRound(&game);
+    // Grow the deck from 2 cards in blocks of 50, emptying it between blocks
+    double seconds = 0;
+    for (long long done = 0; done < iterations; done += 50) {
+        loadDeck(game, game->shoe, 2);
+        double start = benchNow();
+        for (int i = 0; i < 50; i++) {
+            discardCard(game, &game->players[0], card);
         }
+        seconds += benchNow() - start;
+    }
+
+    cleanup(game);
+    free(game);
+    return seconds;
+}
+
+double benchEatChips(long long iterations) {
+    GameState *game = allocateGame(4);
+    initializeGame(game, 4, 5, 1, NULL, 0);
 
-        // Signal the next player's turn
-        signalNextPlayerTurn(&game, (player->id % game.numPlayers) + 1);
+    // New bags are opened along the way, exactly as in a game
+    double start = benchNow();
+    for (long long i = 0; i < iterations; i++) {
+        eatChips(game, &game->players[i & 3]);
     }
-    return NULL;
+    double seconds = benchNow() - start;
+
+    cleanup(game);
+    free(game);
+    return seconds;
 }
 
-int main(int argc, char* argv[]) {
-    // Check for correct number of command-line arguments
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <seed> <num_players> <chips_per_bag>\n", argv[0]);
-        return 1;
+double benchLogAction(long long iterations) {
+    GameState *game = allocateGame(4);
+    initializeGame(game, 4, 5, 1, "/dev/null", 0);
+
+    // Includes waiting for the writer whenever the ring fills up, and the final drain
+    double start = benchNow();
+    for (long long i = 0; i < iterations; i++) {
+        logAction(game, "PLAYER 1: discards 7 at random");
     }
+    closeLog(game->log);
+    game->log = NULL;
+    double seconds = benchNow() - start;
 
-    // Parse command-line arguments
-    int seed = atoi(argv[1]);
-    int numPlayers = atoi(argv[2]);
-    int numChips = atoi(argv[3]);
+    cleanup(game);
+    free(game);
+    return seconds;
+}
 
-    // Seed the random number generator for card shuffling
-    srand(seed);
+double benchLogDeckContents(long long iterations) {
+    GameState *game = allocateGame(4);
+    initializeGame(game, 4, 5, 1, "/dev/null", 0);
 
-    // Initialize the game state with the given parameters
-    initializeGame(&game, numPlayers, numChips);
-
-    // Main game loop to go through all the rounds
-    for (int round = 1; round <= game.totalRounds; round++) {
-        // Start a new round
-        startRound(&game);
-
-        // Create threads for each player, simulating their actions
-        for (int i = 0; i < game.numPlayers; i++) {
-            players[i].id = i + 1;
-            int ret = pthread_create(&players[i].thread, NULL, playerRoutine, (void*)&players[i]);
-            if (ret != 0) {
-                perror("Failed to create the player thread");
-                cleanup(&game);
-                return 1;
+    // A full 52-card deck, the longest DECK line a small table writes
+    double start = benchNow();
+    for (long long i = 0; i < iterations; i++) {
+        logDeckContents(game);
+    }
+    closeLog(game->log);
+    game->log = NULL;
+    double seconds = benchNow() - start;
+
+    cleanup(game);
+    free(game);
+    return seconds;
+}
+
+double benchThreadedGames(int numPlayers, int numGames, bool withLog) {
+    GameState *game = allocateGame(numPlayers);
+    initializeGame(game, numPlayers, 5, 1, withLog ? "/dev/null" : NULL, 0);
+
+    // Back-to-back games on one table, with one persistent thread per player
+    double start = benchNow();
+    startPlayerThreads(game);
+    for (int g = 0; g < numGames; g++) {
+        resetGame(game, gameSeed(1, g));
+        playThreadedGame(game);
+    }
+    stopPlayerThreads(game);
+    if (game->log) {
+        closeLog(game->log);
+        game->log = NULL;
+    }
+    double seconds = benchNow() - start;
+
+    cleanup(game);
+    free(game);
+    return seconds;
+}
+
+double benchHandCheck(bool packed, size_t numHands, long long passes, size_t *found) {
+    // Random hands from many games at once, each with its own greasy card value
+    LegacyHand *legacy = malloc(numHands * sizeof(LegacyHand));
+    PackedCard *slots[HAND_SIZE];
+    for (int s = 0; s < HAND_SIZE; s++) {
+        slots[s] = calloc(numHands, sizeof(PackedCard));
+    }
+    uint8_t *greasy = malloc(numHands);
+    uint8_t *matches = malloc(numHands);
+    if (!legacy || !slots[0] || !slots[HAND_SIZE - 1] || !greasy || !matches) {
+        perror("Error allocating hand benchmark");
+        exit(EXIT_FAILURE);
+    }
+
+    Rng rng;
+    rngSeed(&rng, 1, 0);
+    for (size_t h = 0; h < numHands; h++) {
+        // Most hands are full, some are between a discard and the next draw
+        legacy[h].hand_size = (rngBelow(&rng, 4) == 0) ? 1 : HAND_SIZE;
+        for (int s = 0; s < legacy[h].hand_size; s++) {
+            legacy[h].hand[s].value = (int)rngBelow(&rng, 13) + 1;
+            legacy[h].hand[s].suit = "HDCS"[rngBelow(&rng, 4)];
+            slots[s][h] = packCardByte(legacy[h].hand[s]);
+        }
+        greasy[h] = (uint8_t)(rngBelow(&rng, 13) + 1);
+    }
+
+    size_t hits = 0;
+    double start = benchNow();
+    for (long long p = 0; p < passes; p++) {
+        if (packed) {
+            hits = matchGreasyHands(slots, HAND_SIZE, greasy, matches, numHands);
+        } else {
+            // The loop playTurn used: scan each hand's cards, stop at the first match
+            hits = 0;
+            for (size_t h = 0; h < numHands; h++) {
+                bool hasGreasyCard = false;
+                for (int i = 0; i < legacy[h].hand_size; i++) {
+                    if (legacy[h].hand[i].value == greasy[h]) {
+                        hasGreasyCard = true;
+                        break;
+                    }
+                }
+                matches[h] = hasGreasyCard ? 0xFF : 0;
+                hits += hasGreasyCard;
+            }
+        }
+    }
+    double seconds = benchNow() - start;
+    *found = hits;
+
+    free(legacy);
+    for (int s = 0; s < HAND_SIZE; s++) {
+        free(slots[s]);
+    }
+    free(greasy);
+    free(matches);
+    return seconds;
+}
+
+// Suite entries: iterations counts hands checked, in passes over 4096 hands
+double benchHandCheckLoop(long long iterations) {
+    size_t found;
+    return benchHandCheck(false, 4096, iterations / 4096, &found);
+}
+
+double benchHandCheckPacked(long long iterations) {
+    size_t found;
+    return benchHandCheck(true, 4096, iterations / 4096, &found);
+}
+
+int runHandBenchmark(size_t numHands, long long passes) {
+#if defined(__AVX2__)
+    const char *isa = "AVX2, 32 hands per compare";
+#elif defined(__SSE2__) || defined(_M_X64)
+    const char *isa = "SSE2, 16 hands per compare";
+#else
+    const char *isa = "scalar";
+#endif
+    size_t loopFound, packedFound;
+    double loopSeconds = benchHandCheck(false, numHands, passes, &loopFound);
+    double packedSeconds = benchHandCheck(true, numHands, passes, &packedFound);
+    double checks = (double)numHands * (double)passes;
+
+    printf("Hand check, %zu hands x %lld passes:\n", numHands, passes);
+    printf("  Card[] loop per hand:   %6.2f ns per hand (%.0f M hands/s), %zu holding the greasy card\n",
+           loopSeconds * 1e9 / checks, checks / loopSeconds / 1e6, loopFound);
+    printf("  packed columns (%s): %6.2f ns per hand (%.0f M hands/s), %zu holding the greasy card\n",
+           isa, packedSeconds * 1e9 / checks, checks / packedSeconds / 1e6, packedFound);
+    printf("  Speedup: %.1fx\n", loopSeconds / packedSeconds);
+    return loopFound == packedFound ? 0 : 1;
+}
+
+void addBenchResult(BenchResult results[], int *count, const char *name, const char *unit,
+                    double value, long long iterations, bool higherIsBetter) {
+    if (*count >= BENCH_MAX_RESULTS) {
+        return;
+    }
+    BenchResult *result = &results[(*count)++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->unit = unit;
+    result->value = value;
+    result->iterations = iterations;
+    result->higherIsBetter = higherIsBetter;
+    printf("%-28s %12.1f %s\n", name, value, unit);
+}
+
+bool writeBenchJson(const char *path, const BenchResult results[], int count) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror("Error opening benchmark output");
+        return false;
+    }
+
+    // One object per line so the baseline can be read back with a simple scan
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "    {\"name\": \"%s\", \"unit\": \"%s\", \"value\": %.3f, \"iterations\": %lld, \"higher_is_better\": %s}%s\n",
+                results[i].name, results[i].unit, results[i].value, results[i].iterations,
+                results[i].higherIsBetter ? "true" : "false", (i < count - 1) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+int compareBenchBaseline(const char *path, const BenchResult results[], int count, double thresholdPct) {
+    // Read the whole baseline; it is a file this suite wrote earlier
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror("Error opening benchmark baseline");
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    char *text = malloc((size_t)size + 1);
+    if (!text) {
+        fclose(file);
+        return -1;
+    }
+    size_t length = fread(text, 1, (size_t)size, file);
+    text[length] = '\0';
+    fclose(file);
+
+    printf("\nAgainst baseline %s (threshold %.1f%%):\n", path, thresholdPct);
+    int regressions = 0;
+    for (int i = 0; i < count; i++) {
+        // Find this benchmark's entry and the value that follows it
+        char key[64];
+        snprintf(key, sizeof(key), "\"name\": \"%s\"", results[i].name);
+        char *entry = strstr(text, key);
+        char *value = entry ? strstr(entry, "\"value\":") : NULL;
+        if (!value) {
+            printf("%-28s %12s\n", results[i].name, "new");
+            continue;
+        }
+        double baseline = strtod(value + 8, NULL);
+
+        // Positive change is always a slowdown, whichever direction the unit improves in
+        double change = 0;
+        if (baseline > 0) {
+            change = 100.0 * (results[i].value - baseline) / baseline;
+            if (results[i].higherIsBetter) {
+                change = -change;
+            }
+        }
+        bool regressed = change > thresholdPct;
+        regressions += regressed;
+        printf("%-28s %12.1f -> %12.1f %s  %+6.1f%%%s\n", results[i].name, baseline, results[i].value,
+               results[i].unit, change, regressed ? "  REGRESSION" : "");
+    }
+
+    free(text);
+    return regressions;
+}
+
+int runBenchSuite(const char *outPath, const char *baselinePath, double thresholdPct) {
+    BenchResult results[BENCH_MAX_RESULTS];
+    int count = 0;
+
+    // Microbenchmarks: keep the best of several runs to shed scheduler noise
+    static const struct {
+        const char *name;
+        double (*run)(long long);
+        long long iterations;
+    } micro[] = {
+        { "shuffleDeck", benchShuffle, 200000 },
+        { "drawCard", benchDraw, 1000000 },
+        { "discardCard", benchDiscard, 1000000 },
+        { "eatChips", benchEatChips, 1000000 },
+        { "logAction", benchLogAction, 500000 },
+        { "logDeckContents", benchLogDeckContents, 100000 },
+        { "greasyCheck_loop", benchHandCheckLoop, 4096 * 2000 },
+        { "greasyCheck_packed", benchHandCheckPacked, 4096 * 2000 },
+    };
+    for (size_t m = 0; m < sizeof(micro) / sizeof(micro[0]); m++) {
+        double best = 0;
+        for (int r = 0; r < BENCH_REPEATS; r++) {
+            double seconds = micro[m].run(micro[m].iterations);
+            if (r == 0 || seconds < best) {
+                best = seconds;
             }
         }
+        addBenchResult(results, &count, micro[m].name, "ns/op", best * 1e9 / (double)micro[m].iterations,
+                       micro[m].iterations, false);
+    }
+
+    // Turn round trip: two players passing the token back and forth
+    double best = 0;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        double seconds = timeHandoffs(2, 100000);
+        if (r == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    addBenchResult(results, &count, "waitForTurn+signal", "ns/op", best * 1e9 / 100000.0, 100000, false);
 
-        // Wait for all player threads to finish before proceeding
-        for (int i = 0; i < game.numPlayers; i++) {
-            if (pthread_join(players[i].thread, NULL) != 0) {
-                perror("Failed to join the player thread");
+    // Macro benchmarks: whole threaded games, with the log on and off, best run kept as well
+    static const int playerCounts[] = { 2, 4, 10 };
+    for (size_t p = 0; p < sizeof(playerCounts) / sizeof(playerCounts[0]); p++) {
+        for (int withLog = 0; withLog <= 1; withLog++) {
+            int numGames = 2000 / playerCounts[p];
+            char name[48];
+            snprintf(name, sizeof(name), "games_%dp_%s", playerCounts[p], withLog ? "log" : "nolog");
+            for (int r = 0; r < BENCH_REPEATS; r++) {
+                double seconds = benchThreadedGames(playerCounts[p], numGames, withLog);
+                if (r == 0 || seconds < best) {
+                    best = seconds;
+                }
             }
+            addBenchResult(results, &count, name, "games/s", best > 0 ? numGames / best : 0, numGames, true);
         }
+    }
 
-        // End the current round and prepare for the next
-        endRound(&game);
+    if (!writeBenchJson(outPath, results, count)) {
+        return 1;
+    }
+    printf("Wrote %s\n", outPath);
+
+    // Compare against the stored baseline; any regression fails the run
+    if (baselinePath) {
+        int regressions = compareBenchBaseline(baselinePath, results, count, thresholdPct);
+        if (regressions < 0) {
+            return 1;
+        }
+        printf("%d regression(s)\n", regressions);
+        return regressions > 0 ? 2 : 0;
+    }
+    return 0;
+}
+
+int runSingleGame(uint64_t seed, int numPlayers, int numChips, int logFlushMs, const char *eventsPath) {
+    // Initialize the game state with the given parameters
+    GameState *game = allocateGame(numPlayers);
+    initializeGame(game, numPlayers, numChips, seed, "game_log.txt", logFlushMs);
 
-        // Update the dealer for the next round
-        game.dealerId = (game.dealerId % game.numPlayers) + 1;
+    // Optionally record the binary event stream next to the text log
+    EventSink *events = NULL;
+    if (eventsPath) {
+        events = openEventSink(eventsPath);
+        if (!events) {
+            perror("Error opening the event stream");
+            exit(EXIT_FAILURE);
+        }
+        game->events = events;
     }
 
+    // Play every round with one persistent thread per player
+    startPlayerThreads(game);
+    playThreadedGame(game);
+    stopPlayerThreads(game);
+
     // Clean up resources after the game ends
-    cleanup(&game);
+    cleanup(game);
+    free(game);
+    if (events) {
+        closeEventSink(events);
+    }
+    printf("Game has ended. Thank you for playing!\n"); // Print a message to the console
 
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    // Batch mode: many independent games spread across worker threads
+    if (argc >= 7 && argc <= 9 && strcmp(argv[1], "--batch") == 0) {
+        uint64_t seed = strtoull(argv[2], NULL, 10);
+        int numPlayers = atoi(argv[3]);
+        int numChips = atoi(argv[4]);
+        long long numGames = atoll(argv[5]);
+        int numWorkers = atoi(argv[6]);
+
+        if (numPlayers < 1 || numChips < 1 || numGames < 1 || numWorkers < 1) {
+            fprintf(stderr, "Invalid batch parameters (players, chips, games and workers must be positive)\n");
+            return 1;
+        }
+        // "-" skips the event stream when only the result file is wanted
+        const char *eventsPath = (argc >= 8 && strcmp(argv[7], "-") != 0) ? argv[7] : NULL;
+        const char *resultsPath = (argc == 9) ? argv[8] : NULL;
+        if (eventsPath && numPlayers > EVENT_MAX_PLAYERS) {
+            fprintf(stderr, "Event streams hold at most %d players per table\n", EVENT_MAX_PLAYERS);
+            return 1;
+        }
+        return runBatch(seed, numPlayers, numChips, numGames, numWorkers, &ruleVariants[0], eventsPath, resultsPath, NULL);
+    }
+
+    // Checkpointed batch: the same batch, with every worker's progress saved to a snapshot file
+    if (argc >= 9 && argc <= 11 && strcmp(argv[1], "--checkpoint") == 0) {
+        int checkpointMs = atoi(argv[3]);
+        uint64_t seed = strtoull(argv[4], NULL, 10);
+        int numPlayers = atoi(argv[5]);
+        int numChips = atoi(argv[6]);
+        long long numGames = atoll(argv[7]);
+        int numWorkers = atoi(argv[8]);
+
+        if (checkpointMs < 0 || numPlayers < 1 || numChips < 1 || numGames < 1 || numWorkers < 1) {
+            fprintf(stderr, "Invalid checkpoint parameters (interval must not be negative; players, chips, games and workers must be positive)\n");
+            return 1;
+        }
+        // The same outputs as --batch, recorded in the snapshot so --resume carries on writing them
+        const char *eventsPath = (argc >= 10 && strcmp(argv[9], "-") != 0) ? argv[9] : NULL;
+        const char *resultsPath = (argc == 11) ? argv[10] : NULL;
+        if (eventsPath && numPlayers > EVENT_MAX_PLAYERS) {
+            fprintf(stderr, "Event streams hold at most %d players per table\n", EVENT_MAX_PLAYERS);
+            return 1;
+        }
+        Snapshot *snapshot = createSnapshot(argv[2], seed, numPlayers, numChips, numGames, numWorkers, checkpointMs,
+                                            &ruleVariants[0], eventsPath, resultsPath);
+        if (!snapshot) {
+            return 1;
+        }
+        int status = runBatch(seed, numPlayers, numChips, numGames, numWorkers, &ruleVariants[0], eventsPath,
+                              resultsPath, snapshot);
+        closeSnapshot(snapshot);
+        return status;
+    }
+
+    // Results: scan a per-round result file column by column and print its totals
+    if (argc == 3 && strcmp(argv[1], "--results") == 0) {
+        return runResults(argv[2]);
+    }
+
+    // Resume: continue a checkpointed batch from its snapshot file
+    if (argc == 3 && strcmp(argv[1], "--resume") == 0) {
+        return runResume(argv[2]);
+    }
+
+    // Sweep: the same batch under each rule variant, every one with its own specialized engine
+    if (argc >= 7 && strcmp(argv[1], "--sweep") == 0) {
+        uint64_t seed = strtoull(argv[2], NULL, 10);
+        int numPlayers = atoi(argv[3]);
+        int numChips = atoi(argv[4]);
+        long long numGames = atoll(argv[5]);
+        int numWorkers = atoi(argv[6]);
+
+        if (numPlayers < 1 || numChips < 1 || numGames < 1 || numWorkers < 1) {
+            fprintf(stderr, "Invalid sweep parameters (players, chips, games and workers must be positive)\n");
+            return 1;
+        }
+        return runSweep(seed, numPlayers, numChips, numGames, numWorkers, (const char**)&argv[7], argc - 7);
+    }
+
+    // Table mode: many tables of any size, multiplexed onto a fixed pool of worker threads
+    if (argc == 7 && strcmp(argv[1], "--tables") == 0) {
+        uint64_t seed = strtoull(argv[2], NULL, 10);
+        int numTables = atoi(argv[3]);
+        int numPlayers = atoi(argv[4]);
+        int numChips = atoi(argv[5]);
+        int numWorkers = atoi(argv[6]);
+
+        if (numTables < 1 || numPlayers < 1 || numChips < 1 || numWorkers < 1) {
+            fprintf(stderr, "Invalid table parameters (tables, players, chips and workers must be positive)\n");
+            return 1;
+        }
+        return runTables(seed, numTables, numPlayers, numChips, numWorkers);
+    }
+
+    // Handoff benchmark: time passing the turn around a table of idle players
+    if (argc == 4 && strcmp(argv[1], "--handoff") == 0) {
+        int numPlayers = atoi(argv[2]);
+        long long numTurns = atoll(argv[3]);
+
+        if (numPlayers < 1 || numTurns < 1) {
+            fprintf(stderr, "Invalid handoff parameters (players and turns must be positive)\n");
+            return 1;
+        }
+        return runHandoffBenchmark(numPlayers, numTurns);
+    }
+
+    // Deck benchmark: draw/discard throughput of the deck implementations under contention
+    if (argc == 4 && strcmp(argv[1], "--deck-bench") == 0) {
+        int numThreads = atoi(argv[2]);
+        long long opsPerThread = atoll(argv[3]);
+
+        if (numThreads < 1 || opsPerThread < 1) {
+            fprintf(stderr, "Invalid deck benchmark parameters (threads and operations must be positive)\n");
+            return 1;
+        }
+        return runDeckBenchmark(numThreads, opsPerThread);
+    }
+
+    // Conformance: play the same seeds on the threaded and the fast engine and compare their events
+    if (argc == 6 && strcmp(argv[1], "--conform") == 0) {
+        uint64_t seed = strtoull(argv[2], NULL, 10);
+        int numPlayers = atoi(argv[3]);
+        int numChips = atoi(argv[4]);
+        long long numGames = atoll(argv[5]);
+
+        if (numPlayers < 1 || numPlayers > MAX_PLAYERS || numChips < 1 || numGames < 1) {
+            fprintf(stderr, "Invalid conformance parameters (players 1-%d, chips and games must be positive)\n", MAX_PLAYERS);
+            return 1;
+        }
+        return runConformance(seed, numPlayers, numChips, numGames);
+    }
+
+    // Hand-check benchmark: greasy-card matching over many hands, per-hand loop against packed columns
+    if (argc == 4 && strcmp(argv[1], "--hand-bench") == 0) {
+        long long numHands = atoll(argv[2]);
+        long long passes = atoll(argv[3]);
+
+        if (numHands < 1 || passes < 1) {
+            fprintf(stderr, "Invalid hand benchmark parameters (hands and passes must be positive)\n");
+            return 1;
+        }
+        return runHandBenchmark((size_t)numHands, passes);
+    }
+
+    // Replay: re-check a binary event stream, or render it as the text log
+    if (argc == 4 && strcmp(argv[1], "--replay") == 0) {
+        if (strcmp(argv[3], "check") != 0 && strcmp(argv[3], "text") != 0) {
+            fprintf(stderr, "Replay action must be check or text\n");
+            return 1;
+        }
+        return runReplay(argv[2], strcmp(argv[3], "text") == 0);
+    }
+
+    // Benchmark suite: hot-path microbenchmarks and whole games, written as JSON and
+    // optionally compared against a baseline written by an earlier run
+    if (argc >= 3 && argc <= 5 && strcmp(argv[1], "--bench") == 0) {
+        const char *baselinePath = (argc >= 4) ? argv[3] : NULL;
+        double thresholdPct = (argc == 5) ? atof(argv[4]) : BENCH_DEFAULT_THRESHOLD;
+
+        if (thresholdPct < 0) {
+            fprintf(stderr, "Invalid benchmark threshold (must not be negative)\n");
+            return 1;
+        }
+        return runBenchSuite(argv[2], baselinePath, thresholdPct);
+    }
+
+    // Check for correct number of command-line arguments
+    if (argc < 4 || argc > 6) {
+        fprintf(stderr, "Usage: %s <seed> <num_players> <chips_per_bag> [log_flush_ms] [events_file]\n", argv[0]);
+        fprintf(stderr, "       %s --batch <seed> <num_players> <chips_per_bag> <num_games> <num_workers> [events_file|-] [results_file]\n", argv[0]);
+        fprintf(stderr, "       %s --checkpoint <snapshot_file> <interval_ms> <seed> <num_players> <chips_per_bag> <num_games> <num_workers> [events_file|-] [results_file]\n", argv[0]);
+        fprintf(stderr, "       %s --resume <snapshot_file>\n", argv[0]);
+        fprintf(stderr, "       %s --results <results_file>\n", argv[0]);
+        fprintf(stderr, "       %s --sweep <seed> <num_players> <chips_per_bag> <num_games> <num_workers> [variant ...]\n", argv[0]);
+        fprintf(stderr, "       %s --tables <seed> <num_tables> <players_per_table> <chips_per_bag> <num_workers>\n", argv[0]);
+        fprintf(stderr, "       %s --conform <seed> <num_players> <chips_per_bag> <num_games>\n", argv[0]);
+        fprintf(stderr, "       %s --handoff <num_players> <num_turns>\n", argv[0]);
+        fprintf(stderr, "       %s --deck-bench <num_threads> <ops_per_thread>\n", argv[0]);
+        fprintf(stderr, "       %s --hand-bench <num_hands> <passes>\n", argv[0]);
+        fprintf(stderr, "       %s --bench <output.json> [baseline.json] [threshold_pct]\n", argv[0]);
+        fprintf(stderr, "       %s --replay <events_file> check|text\n", argv[0]);
+        return 1;
+    }
+
+    // Parse command-line arguments
+    uint64_t seed = strtoull(argv[1], NULL, 10);
+    int numPlayers = atoi(argv[2]);
+    int numChips = atoi(argv[3]);
+    // How long the log writer may hold records before writing them, 0 writes as soon as the ring runs dry
+    int logFlushMs = (argc >= 5) ? atoi(argv[4]) : 0;
+    // Where to write the binary event stream, if anywhere
+    const char *eventsPath = (argc == 6) ? argv[5] : NULL;
+
+    if (numPlayers < 1 || numPlayers > MAX_PLAYERS || numChips < 1 || logFlushMs < 0) {
+        fprintf(stderr, "Invalid parameters (players 1-%d, chips must be positive, flush interval not negative)\n", MAX_PLAYERS);
+        return 1;
+    }
+
+    return runSingleGame(seed, numPlayers, numChips, logFlushMs, eventsPath);
+}
@@ -0,0 +1,97 @@
+// PID controller for the drive and rotate maneuvers.
+//
+// The controller runs at a fixed period, so the integral and derivative gains
+// are scaled by it once, in the constructor, and update() is a handful of
+// multiply-adds. The derivative acts on the measurement rather than the error,
+// so a new setpoint doesn't kick the output, and goes through a first-order
+// low-pass to keep gyro noise off the motors. The integral is clamped to the
+// output range and stops growing while the output is saturated in the
+// direction it would push it (anti-windup).
+//
+// The arithmetic is Q16.16 fixed point by default: 16 integer bits hold
+// degrees and PWM duty comfortably, and the cost doesn't depend on having an
+// FPU or on denormals. Define PID_FIXED_POINT as 0 before including this
+// header to run it in float instead; sim/PidBench.cpp times both.
+#ifndef PID_CONTROLLER_H
+#define PID_CONTROLLER_H
+
+#include <stdint.h>
+
+#ifndef PID_FIXED_POINT
+#define PID_FIXED_POINT 1
+#endif
+
+struct PidGains {
+  float kp;            // Output per unit of error
+  float ki;            // Output per unit of error per second
+  float kd;            // Output per unit of measurement change per second
+  float filterS;       // Time constant of the derivative low-pass, 0 for none
+  float outputLimit;   // Output and integral are kept within +-outputLimit
+};
+
+class PidController {
+public:
+  PidController(const PidGains &gains, float periodS)
+    : kp(toValue(gains.kp)),
+      kiT(toValue(gains.ki * periodS)),
+      kdT(toValue(gains.kd / periodS)),
+      alpha(toValue(periodS / (gains.filterS + periodS))),
+      limit(toValue(gains.outputLimit)) {
+    reset(0.0f);
+  }
+
+  // Clears the integral and derivative history; the next update() measures change from here
+  void reset(float measurement) {
+    integral = 0;
+    derivative = 0;
+    lastMeasurement = toValue(measurement);
+  }
+
+  // One control period: returns the output for the latest measurement
+  float update(float setpoint, float measurement) {
+    Value m = toValue(measurement);
+    Value error = toValue(setpoint) - m;
+
+    derivative += mul(alpha, mul(kdT, lastMeasurement - m) - derivative);
+    lastMeasurement = m;
+
+    Value nextIntegral = clamp(integral + mul(kiT, error));
+    Value output = mul(kp, error) + nextIntegral + derivative;
+    if (output > limit) {
+      output = limit;
+      if (error > 0) nextIntegral = integral;
+    } else if (output < -limit) {
+      output = -limit;
+      if (error < 0) nextIntegral = integral;
+    }
+    integral = nextIntegral;
+    return toFloat(output);
+  }
+
+private:
+#if PID_FIXED_POINT
+  typedef int32_t Value;
+  static const int FRACTION_BITS = 16;
+
+  static Value toValue(float x) {
+    return (Value)(x * (1 << FRACTION_BITS) + (x >= 0 ? 0.5f : -0.5f));
+  }
+  static float toFloat(Value x) { return x / (float)(1 << FRACTION_BITS); }
+  static Value mul(Value a, Value b) { return (Value)(((int64_t)a * b) >> FRACTION_BITS); }
+#else
+  typedef float Value;
+
+  static Value toValue(float x) { return x; }
+  static float toFloat(Value x) { return x; }
+  static Value mul(Value a, Value b) { return a * b; }
+#endif
+
+  Value clamp(Value x) const { return x > limit ? limit : (x < -limit ? -limit : x); }
+
+  Value kp, kiT, kdT, alpha, limit;
+  Value integral;
+  Value derivative;
+  Value lastMeasurement;
+};
+
+#endif
@@ -0,0 +1,71 @@
+// Lock-free channel for handing one task's latest sample to other tasks.
+//
+// One task publishes a whole struct at a time; any number of tasks read the
+// newest complete one. It is a sequence lock: the version is odd while a
+// publish is under way, and a reader that saw it change retries the copy.
+// Neither side ever blocks or takes a mutex, and a reader never sees half of
+// one sample and half of the next.
+//
+// The payload is stored as atomic words with release/acquire ordering instead
+// of fences, so the copies are race-free and thread sanitizers can check them.
+// A reader only retries while a publish overlaps its copy, which takes well
+// under a microsecond; it must not run at a higher priority than the writer
+// on the writer's own core, or it could spin until preempted.
+#ifndef SNAPSHOT_CHANNEL_H
+#define SNAPSHOT_CHANNEL_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+template <typename T>
+class SnapshotChannel {
+  static_assert(std::is_trivially_copyable<T>::value, "snapshots are copied word by word");
+
+public:
+  // Writer only
+  void publish(const T &value) {
+    uint32_t buffer[WORDS] = {0};
+    memcpy(buffer, &value, sizeof(T));
+
+    uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    for (size_t i = 0; i < WORDS; i++) {
+      // A reader that sees this word also sees the odd version stored before it
+      words[i].store(buffer[i], std::memory_order_release);
+    }
+    sequence.store(seq + 2, std::memory_order_release);
+  }
+
+  // Copies the newest complete snapshot into out and returns its version,
+  // which counts publishes; 0 means nothing has been published yet and out
+  // is left alone.
+  uint32_t read(T &out) const {
+    uint32_t buffer[WORDS];
+    for (;;) {
+      uint32_t before = sequence.load(std::memory_order_acquire);
+      if (before & 1) {
+        continue;  // Publish under way
+      }
+      for (size_t i = 0; i < WORDS; i++) {
+        buffer[i] = words[i].load(std::memory_order_acquire);
+      }
+      if (sequence.load(std::memory_order_relaxed) == before) {
+        if (before != 0) {
+          memcpy(&out, buffer, sizeof(T));
+        }
+        return before / 2;
+      }
+    }
+  }
+
+private:
+  static const size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+  std::atomic<uint32_t> sequence{0};
+  std::atomic<uint32_t> words[WORDS] = {};
+};
+
+#endif
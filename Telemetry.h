@@ -0,0 +1,123 @@
+// Binary telemetry for the control loops.
+//
+// A control task records one fixed-size TelemetrySample per pass into a
+// TelemetryRing, which costs a copy and two atomic stores and never waits.
+// A low-priority task pops the samples, wraps each in a frame and writes it
+// to the serial port; sim/TelemetryDecode.cpp turns a capture of that port
+// back into CSV. When the drain task falls behind, new samples are dropped
+// and the gap shows in their sequence numbers rather than stalling the loop.
+//
+// A frame is the two sync bytes, the sample as laid out in memory
+// (little-endian, as on the ESP32 and the host) and a Fletcher-16 checksum
+// of the sample. Text the sketch still prints can sit between frames; the
+// decoder skips anything that doesn't check out.
+//
+// Building with TELEMETRY_ENABLED defined as 0 leaves the sketches' record
+// calls and drain task out.
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef TELEMETRY_ENABLED
+#define TELEMETRY_ENABLED 1
+#endif
+
+const uint16_t TELEMETRY_NO_DISTANCE = 0xFFFF;   // Sensor absent or nothing in range
+const int16_t TELEMETRY_NO_VELOCITY = -32768;    // Not measured
+const uint8_t TELEMETRY_SYNC0 = 0xA5;
+const uint8_t TELEMETRY_SYNC1 = 0x5A;
+
+struct TelemetrySample {
+  uint32_t stampUs;         // micros() when recorded
+  int32_t headingCdeg;      // Hundredths of a degree, counter-clockwise positive
+  int16_t velocityMmS;      // Forward
+  uint16_t distanceMm[3];   // Center, left, right
+  uint16_t seq;             // Counts every sample recorded, dropped ones included
+  uint8_t pwmLeft;          // Last duty written to each motor
+  uint8_t pwmRight;
+  uint8_t state;            // The sketch's state enum
+  uint8_t irCode;           // Line sensor code as the sketch reads it
+  uint8_t flags;            // Sketch-defined
+  uint8_t reserved;
+};
+static_assert(sizeof(TelemetrySample) == 24, "the frame layout depends on the sample having no padding");
+
+const size_t TELEMETRY_FRAME_BYTES = 2 + sizeof(TelemetrySample) + 2;
+
+inline uint16_t telemetryChecksum(const uint8_t *data, size_t length) {
+  uint16_t sum1 = 0, sum2 = 0;
+  for (size_t i = 0; i < length; i++) {
+    sum1 = (sum1 + data[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (uint16_t)((sum2 << 8) | sum1);
+}
+
+inline void telemetryEncode(const TelemetrySample &sample, uint8_t *frame) {
+  frame[0] = TELEMETRY_SYNC0;
+  frame[1] = TELEMETRY_SYNC1;
+  memcpy(frame + 2, &sample, sizeof(sample));
+  uint16_t check = telemetryChecksum(frame + 2, sizeof(sample));
+  frame[2 + sizeof(sample)] = (uint8_t)(check & 0xFF);
+  frame[3 + sizeof(sample)] = (uint8_t)(check >> 8);
+}
+
+// False unless frame holds TELEMETRY_FRAME_BYTES of a well-formed frame
+inline bool telemetryDecode(const uint8_t *frame, TelemetrySample *sample) {
+  if (frame[0] != TELEMETRY_SYNC0 || frame[1] != TELEMETRY_SYNC1) {
+    return false;
+  }
+  uint16_t check = (uint16_t)(frame[2 + sizeof(TelemetrySample)] | (frame[3 + sizeof(TelemetrySample)] << 8));
+  if (telemetryChecksum(frame + 2, sizeof(TelemetrySample)) != check) {
+    return false;
+  }
+  memcpy(sample, frame + 2, sizeof(TelemetrySample));
+  return true;
+}
+
+// Single-producer, single-consumer ring of samples
+template <size_t CAPACITY>
+class TelemetryRing {
+  static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+public:
+  // Recording task only. Stamps the sequence number; returns false and drops
+  // the sample when the ring is full.
+  bool push(TelemetrySample &sample) {
+    sample.seq = (uint16_t)recorded++;
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == CAPACITY) {
+      droppedCount.store(droppedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    slots[h & (CAPACITY - 1)] = sample;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Drain task only
+  bool pop(TelemetrySample &out) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    out = slots[t & (CAPACITY - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+  TelemetrySample slots[CAPACITY];
+  uint32_t recorded = 0;
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+  std::atomic<uint32_t> droppedCount{0};
+};
+
+#endif
@@ -0,0 +1,18 @@
+// Host stand-in for the DFRobot BMI160 driver. Readings come from the
+// simulated robot's motion; each read costs the time of the I2C transfer.
+#ifndef SIM_DFROBOT_BMI160_H
+#define SIM_DFROBOT_BMI160_H
+
+#include "Arduino.h"
+
+#define BMI160_OK 0
+
+class DFRobot_BMI160 {
+public:
+    int8_t softReset();
+    int8_t I2cInit(int8_t i2c_addr = 0x69);
+    // Gyro x, y, z then accel x, y, z, raw counts (16.4 LSB per deg/s, 16384 LSB per g)
+    int8_t getAccelGyroData(int16_t *data);
+};
+
+#endif
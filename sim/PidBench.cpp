@@ -0,0 +1,200 @@
+// Step-response and cost benchmark for PidController.
+//
+//   g++ -O2 -std=c++17 -I. sim/PidBench.cpp -o pid_bench
+//   g++ -O2 -std=c++17 -I. -DPID_FIXED_POINT=0 sim/PidBench.cpp -o pid_bench_float
+//   ./pid_bench [--iterations N]
+//
+// Each profile runs one of the sketches' maneuvers against the drive model of
+// SimWorld.cpp: wheel speeds follow the commanded duty through a deadband and
+// a first-order lag, and the heading integrates their difference. The
+// controller steps every 10 ms, the physics every 1 ms. A turn is reported
+// twice: run on past the tolerance, for settling time and overshoot, and as
+// the sketch runs it, stopping at the tolerance and coasting. The gains are
+// copies of the sketches' and have to be kept in step with them.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "PidController.h"
+
+// Drive model, as in SimWorld.cpp
+#define WHEEL_BASE 0.14
+#define MAX_WHEEL_SPEED 0.6
+#define MOTOR_DEADBAND 0.15
+#define MOTOR_TAU 0.06
+#define LANE_LOAD 0.7
+#define STEP_S 0.001
+
+#define PERIOD_MS 10
+#define TOLERANCE_DEG 2.0
+#define RUN_S 3.0
+#define COAST_S 0.3
+
+enum { TURN, HOLD };
+
+struct Profile {
+    const char *name;
+    int kind;
+    PidGains gains;
+    float target;        // Turn: degrees to turn. Hold: heading error to start from
+    int minPwm, maxPwm;  // Turn: duty range. Hold: maxPwm is the base duty
+    double load;         // Share of top speed left
+};
+
+static const Profile profiles[] = {
+    { "Push small turn -15",  TURN, { 3.0f, 1.0f, 0.15f, 0.03f, 80 },  -15, 100, 180, 1.0 },
+    { "Push big turn 120",    TURN, { 2.5f, 0.0f, 0.25f, 0.03f, 135 }, 120, 120, 255, 1.0 },
+    { "Push big turn 180",    TURN, { 2.5f, 0.0f, 0.25f, 0.03f, 135 }, 180, 120, 255, 1.0 },
+    { "Pull small turn 15",   TURN, { 3.0f, 1.0f, 0.15f, 0.03f, 40 },  15, 160, 200, LANE_LOAD },
+    { "Push heading hold 5",  HOLD, { 6.0f, 2.0f, 0.05f, 0.03f, 80 },  5, 100, 180, 1.0 },
+    { "Pull heading hold 5",  HOLD, { 15.0f, 5.0f, 0.07f, 0.03f, 95 }, 5, 160, 255, LANE_LOAD },
+};
+
+struct Plant {
+    double vLeft, vRight;
+    double headingDeg;
+    double load;
+};
+
+struct Response {
+    double settleS;      // Last time the error was outside the tolerance, -1 if it never settled
+    double overshootDeg; // Furthest past the target, 0 if never
+    double finalErrorDeg;
+    double stopS;        // Turns run as the sketch does: when the loop exited
+    double stopErrorDeg; // and the error after coasting to rest
+};
+
+// Function Prototypes
+static double wheelTarget(int duty, double load);
+static void stepPlant(Plant *plant, int dutyLeft, int dutyRight);
+static void command(const Profile *p, float output, int *dutyLeft, int *dutyRight);
+static void simulate(const Profile *p, bool stopAtTolerance, Response *response);
+static double timeUpdates(long iterations);
+
+static double wheelTarget(int duty, double load) {
+    double d = std::fabs(duty / 255.0);
+    if (d <= MOTOR_DEADBAND) return 0.0;
+    return std::copysign((d - MOTOR_DEADBAND) / (1.0 - MOTOR_DEADBAND) * MAX_WHEEL_SPEED * load, (double)duty);
+}
+
+static void stepPlant(Plant *plant, int dutyLeft, int dutyRight) {
+    plant->vLeft += (wheelTarget(dutyLeft, plant->load) - plant->vLeft) * STEP_S / MOTOR_TAU;
+    plant->vRight += (wheelTarget(dutyRight, plant->load) - plant->vRight) * STEP_S / MOTOR_TAU;
+    plant->headingDeg += (plant->vRight - plant->vLeft) / WHEEL_BASE * STEP_S * 180.0 / M_PI;
+}
+
+// Signed wheel duties for one controller output, the way Rotate and Forward map it
+static void command(const Profile *p, float output, int *dutyLeft, int *dutyRight) {
+    if (p->kind == TURN) {
+        int pwm = p->minPwm + (int)std::fabs(output);
+        if (pwm > p->maxPwm) pwm = p->maxPwm;
+        *dutyLeft = output < 0 ? pwm : -pwm;
+        *dutyRight = output < 0 ? -pwm : pwm;
+    } else {
+        int trimmed = p->maxPwm - (int)std::fabs(output);
+        if (trimmed < p->minPwm) trimmed = p->minPwm;
+        *dutyLeft = output < 0 ? p->maxPwm : trimmed;
+        *dutyRight = output < 0 ? trimmed : p->maxPwm;
+    }
+}
+
+static void simulate(const Profile *p, bool stopAtTolerance, Response *response) {
+    Plant plant = { 0, 0, p->kind == HOLD ? p->target : 0.0, p->load };
+    float setpoint = p->kind == TURN ? p->target : 0.0f;
+    if (p->kind == HOLD) {
+        // Already driving straight at the base duty when the error appears
+        plant.vLeft = plant.vRight = wheelTarget(p->maxPwm, p->load);
+    }
+    PidController pid(p->gains, PERIOD_MS / 1000.0f);
+    pid.reset((float)plant.headingDeg);
+
+    memset(response, 0, sizeof(*response));
+    response->stopS = -1;
+    int dutyLeft = 0, dutyRight = 0;
+    double lastOutside = 0;
+    int steps = (int)(RUN_S / STEP_S);
+    for (int i = 0; i < steps; i++) {
+        double t = i * STEP_S;
+        double error = setpoint - plant.headingDeg;
+        if (i % PERIOD_MS == 0 && response->stopS < 0) {
+            if (stopAtTolerance && std::fabs(error) < TOLERANCE_DEG) {
+                response->stopS = t;
+                dutyLeft = dutyRight = 0;
+            } else {
+                command(p, pid.update(setpoint, (float)plant.headingDeg), &dutyLeft, &dutyRight);
+            }
+        }
+        stepPlant(&plant, dutyLeft, dutyRight);
+
+        double start = p->kind == TURN ? 0.0 : p->target;
+        double past = (plant.headingDeg - setpoint) * (setpoint > start ? 1 : -1);
+        if (past > response->overshootDeg) response->overshootDeg = past;
+        if (std::fabs(setpoint - plant.headingDeg) > TOLERANCE_DEG) lastOutside = t + STEP_S;
+        if (response->stopS >= 0 && t - response->stopS > COAST_S) break;
+    }
+    response->finalErrorDeg = setpoint - plant.headingDeg;
+    response->settleS = lastOutside >= RUN_S - STEP_S ? -1 : lastOutside;
+    if (response->stopS >= 0) response->stopErrorDeg = response->finalErrorDeg;
+}
+
+// Controller cost alone, fed a wandering measurement so nothing folds away
+static double timeUpdates(long iterations) {
+    PidController pid(profiles[0].gains, PERIOD_MS / 1000.0f);
+    volatile float sink = 0;
+    float measurement = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        measurement += ((uint32_t)(i * 2654435761u) >> 28) * 0.25f - 1.875f;
+        if (measurement > 90 || measurement < -90) measurement = 0;
+        sink = pid.update(15.0f, measurement);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+    (void)sink;
+    return ns / iterations;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = 20000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atol(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1) {
+        fprintf(stderr, "Iterations must be positive\n");
+        return 1;
+    }
+
+    printf("PidController, %s, %d ms period, +-%.0f deg tolerance\n",
+           PID_FIXED_POINT ? "Q16.16 fixed point" : "float", PERIOD_MS, TOLERANCE_DEG);
+    printf("%-22s %10s %10s %10s %10s %12s\n", "Profile", "Settle", "Overshoot", "Final", "Stop", "Stopped at");
+    for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        const Profile *p = &profiles[i];
+        Response run, stop;
+        simulate(p, false, &run);
+        char settle[16];
+        if (run.settleS < 0) {
+            snprintf(settle, sizeof(settle), "never");
+        } else {
+            snprintf(settle, sizeof(settle), "%.0fms", run.settleS * 1000);
+        }
+        printf("%-22s %10s %8.2fdeg %7.2fdeg", p->name, settle, run.overshootDeg, run.finalErrorDeg);
+        if (p->kind == TURN) {
+            simulate(p, true, &stop);
+            if (stop.stopS < 0) {
+                printf(" %10s %12s\n", "timeout", "");
+            } else {
+                printf(" %8.0fms %9.2fdeg\n", stop.stopS * 1000, p->target - stop.stopErrorDeg);
+            }
+        } else {
+            printf(" %10s %12s\n", "-", "-");
+        }
+    }
+    printf("update(): %.1f ns per iteration over %ld iterations\n", timeUpdates(iterations), iterations);
+    return 0;
+}
@@ -0,0 +1,13 @@
+// PullAlgorithm, compiled unchanged for the host, on the lane.
+#include "Arduino.h"
+#include "Sim.h"
+
+#include "../PullAlgorithm"
+
+const SimWiring simWiring = {
+    "PullAlgorithm", ARENA_LANE,
+    { FrontLeftSensor, FrontRightSensor, BackLeftSensor, BackRightSensor }, HIGH,
+    { -1, -1, -1 },
+    { -1, -1, -1 },
+    PWML, PWMR, L_IN1, L_IN2, R_IN1, R_IN2, STBY, BUTTON_PIN
+};
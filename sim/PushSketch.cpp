@@ -0,0 +1,13 @@
+// PushAlgorithm, compiled unchanged for the host, in the sumo ring.
+#include "Arduino.h"
+#include "Sim.h"
+
+#include "../PushAlgorithm"
+
+const SimWiring simWiring = {
+    "PushAlgorithm", ARENA_RING,
+    { IRSensor1, IRSensor2, IRSensor3, IRSensor4 }, LOW,
+    { CenterTrigPin, LeftTrigPin, RightTrigPin },
+    { CenterEchoPin, LeftEchoPin, RightEchoPin },
+    PWML, PWMR, L_IN1, L_IN2, R_IN1, R_IN2, STBY, BUTTON_PIN
+};
@@ -0,0 +1,102 @@
+// Interface between the simulator's parts: the runtime behind the Arduino and
+// FreeRTOS stand-ins (SimRuntime.cpp), the arena and robot model (SimWorld.cpp),
+// the match runner (SimMain.cpp) and the sketch being tested (PushSketch.cpp or
+// PullSketch.cpp). Nothing here is visible to the sketch itself.
+#ifndef SIM_H
+#define SIM_H
+
+#include <cstdint>
+
+#define SIM_MAX_TASKS 8
+#define SIM_MAX_INTERRUPTS 8
+#define SIM_TASK_NAME 24
+#define SIM_PERIOD_BUCKETS 2000      // 1 ms buckets; the last one also holds anything slower
+#define SIM_NEVER UINT64_MAX
+
+// Arenas
+enum {
+    ARENA_RING,              // Sumo ring with a white edge and a passive opponent (PushAlgorithm)
+    ARENA_LANE               // Straight lane with side lines and an end line (PullAlgorithm)
+};
+
+// How the match ended
+enum {
+    OUTCOME_WIN,             // Ring: the opponent left the ring
+    OUTCOME_LOSS,            // Ring: the robot left the ring
+    OUTCOME_ARRIVED,         // Lane: the robot reached the end line
+    OUTCOME_OUT,             // Lane: the robot crossed a side line
+    OUTCOME_STALLED,         // Lane: the motors stayed off before the end line was reached
+    OUTCOME_TIMEOUT,         // Time limit reached
+    OUTCOME_COUNT
+};
+
+// Pin assignment of the sketch, filled in from the sketch's own constants
+struct SimWiring {
+    const char *name;
+    int arena;
+    int irPins[4];           // Front-left, front-right, back-left, back-right
+    int irLineLevel;         // Level an IR sensor reads over the white line
+    int trigPins[3];         // Ultrasonic sensors: center, left, right; -1 when absent
+    int echoPins[3];
+    int pwmLeft, pwmRight;
+    int leftIn1, leftIn2;    // IN1 high and IN2 low drives the wheel forward
+    int rightIn1, rightIn2;
+    int standby;
+    int button;
+};
+extern const SimWiring simWiring;
+
+// Loop timing of one task. A period runs from one vTaskDelay call to the next;
+// the body is the part of it spent outside vTaskDelay.
+struct SimTaskStats {
+    char name[SIM_TASK_NAME];
+    long long iterations;
+    uint64_t periodSumUs;
+    uint64_t periodMaxUs;
+    uint64_t bodySumUs;
+    uint64_t bodyMaxUs;
+    long long periodHist[SIM_PERIOD_BUCKETS];
+};
+
+// Everything a match reports back to the runner
+struct SimResult {
+    int outcome;
+    double startS;           // Virtual time of the first drive command, after the countdown
+    double endS;             // Time from start to the outcome
+    double firstLineS;       // Time from start until an IR sensor first reached a line, -1 if never
+    long long reactions;     // Line contacts followed by a change of motor command
+    double reactionSumMs;
+    double reactionMaxMs;
+    long long serialBytes;
+    double serialBlockedMs;  // Time tasks spent waiting for the UART
+    double simulatedS;
+    int numTasks;
+    SimTaskStats tasks[SIM_MAX_TASKS];
+};
+
+struct SimConfig {
+    uint64_t seed;
+    double timeLimitS;       // Measured from the first drive command
+    bool trace;              // Echo the sketch's serial output with virtual timestamps
+    const char *serialPath;  // Append the raw serial output to this file, NULL for none
+};
+
+// Runtime: virtual clock and tasks
+uint64_t simNow();
+void simSpend(uint64_t us);          // Busy time of the running task, e.g. a register access
+void simBlock(uint64_t us);          // The running task waits, e.g. a delay or an I2C transfer
+void simRunMatch(const SimConfig *config, SimResult *result);
+
+// World: arena, robot and sensors
+void worldInit(const SimWiring *wiring, uint64_t seed);
+void worldAdvance(uint64_t nowUs);
+bool worldDone(uint64_t nowUs, double timeLimitS);
+void worldDigitalWrite(int pin, int level, uint64_t nowUs);
+int worldDigitalRead(int pin, uint64_t nowUs);
+void worldAnalogWrite(int pin, int value, uint64_t nowUs);
+bool worldEchoWindow(int pin, uint64_t *riseUs, uint64_t *fallUs);
+bool worldNextEdge(int pin, uint64_t afterUs, uint64_t *edgeUs);
+void worldImu(int16_t data[6]);
+void worldReport(SimResult *result, uint64_t nowUs);
+
+#endif
@@ -0,0 +1,221 @@
+// Match runner for the host simulator.
+//
+// Builds one simulator per sketch; the sketch source is compiled unchanged
+// against the stand-ins in this directory:
+//
+//   g++ -O2 -std=c++17 -pthread -Isim sim/SimRuntime.cpp sim/SimWorld.cpp sim/SimMain.cpp sim/PushSketch.cpp -o push_sim
+//   g++ -O2 -std=c++17 -pthread -Isim sim/SimRuntime.cpp sim/SimWorld.cpp sim/SimMain.cpp sim/PullSketch.cpp -o pull_sim
+//
+//   ./push_sim [--matches N] [--seed S] [--time-limit seconds] [--trace] [--serial-out file]
+//
+// --serial-out captures the raw serial output of every match, one after the
+// other, for sim/TelemetryDecode.cpp.
+//
+// Each match runs in a forked child, so the sketch's globals and the parked
+// task threads start fresh every time; the child sends its SimResult back
+// through a pipe. Match i uses seed S + i.
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Sim.h"
+
+static const char *outcomeNames[OUTCOME_COUNT] = { "win", "loss", "arrived", "out", "stalled", "timeout" };
+
+// Totals over all matches; task stats are summed by creation order
+struct Summary {
+    int matches;
+    int outcomes[OUTCOME_COUNT];
+    double startSum, endSum, lineSum, simulatedS, serialBlockedMs;
+    int lineCount;
+    long long reactions, serialBytes;
+    double reactionSumMs, reactionMaxMs;
+    int numTasks;
+    SimTaskStats tasks[SIM_MAX_TASKS];
+};
+
+// Function Prototypes
+static bool runOne(const SimConfig *config, SimResult *result);
+static void addResult(Summary *summary, const SimResult *result);
+static double percentile(const long long *hist, long long count, double p);
+static void printReport(const Summary *summary, double wallS);
+
+static bool runOne(const SimConfig *config, SimResult *result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return false;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        simRunMatch(config, result);
+        fflush(stdout);
+        const char *p = (const char*)result;
+        size_t left = sizeof(SimResult);
+        while (left > 0) {
+            ssize_t n = write(fds[1], p, left);
+            if (n <= 0) _exit(1);
+            p += n;
+            left -= (size_t)n;
+        }
+        _exit(0); // Skip destructors; the task threads are still parked
+    }
+
+    // Read before waiting: the result is bigger than a pipe buffer
+    close(fds[1]);
+    char *p = (char*)result;
+    size_t got = 0;
+    while (got < sizeof(SimResult)) {
+        ssize_t n = read(fds[0], p + got, sizeof(SimResult) - got);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (got != sizeof(SimResult) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Match with seed %llu failed\n", (unsigned long long)config->seed);
+        return false;
+    }
+    return true;
+}
+
+static double percentile(const long long *hist, long long count, double p) {
+    long long target = (long long)(count * p);
+    long long seen = 0;
+    for (int i = 0; i < SIM_PERIOD_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen > target) {
+            return i + 1; // Upper edge of the 1 ms bucket
+        }
+    }
+    return SIM_PERIOD_BUCKETS;
+}
+
+static void addResult(Summary *summary, const SimResult *r) {
+    summary->matches++;
+    summary->outcomes[r->outcome]++;
+    summary->startSum += r->startS;
+    summary->endSum += r->endS;
+    if (r->firstLineS >= 0) {
+        summary->lineSum += r->firstLineS;
+        summary->lineCount++;
+    }
+    summary->reactions += r->reactions;
+    summary->reactionSumMs += r->reactionSumMs;
+    if (r->reactionMaxMs > summary->reactionMaxMs) summary->reactionMaxMs = r->reactionMaxMs;
+    summary->serialBytes += r->serialBytes;
+    summary->serialBlockedMs += r->serialBlockedMs;
+    summary->simulatedS += r->simulatedS;
+
+    if (r->numTasks > summary->numTasks) summary->numTasks = r->numTasks;
+    for (int t = 0; t < r->numTasks; t++) {
+        const SimTaskStats &s = r->tasks[t];
+        SimTaskStats &total = summary->tasks[t];
+        strcpy(total.name, s.name);
+        total.iterations += s.iterations;
+        total.periodSumUs += s.periodSumUs;
+        total.bodySumUs += s.bodySumUs;
+        if (s.periodMaxUs > total.periodMaxUs) total.periodMaxUs = s.periodMaxUs;
+        if (s.bodyMaxUs > total.bodyMaxUs) total.bodyMaxUs = s.bodyMaxUs;
+        for (int b = 0; b < SIM_PERIOD_BUCKETS; b++) total.periodHist[b] += s.periodHist[b];
+    }
+}
+
+static void printReport(const Summary *summary, double wallS) {
+    int n = summary->matches;
+    printf("Sketch: %s, %d matches\n", simWiring.name, n);
+    printf("Outcomes:");
+    for (int i = 0; i < OUTCOME_COUNT; i++) {
+        if (summary->outcomes[i]) {
+            printf(" %s %d (%.1f%%)", outcomeNames[i], summary->outcomes[i], 100.0 * summary->outcomes[i] / n);
+        }
+    }
+    printf("\n");
+    printf("Start after %.3f s; first line after %.3f s (%d matches); outcome after %.3f s\n",
+           summary->startSum / n, summary->lineCount ? summary->lineSum / summary->lineCount : 0.0,
+           summary->lineCount, summary->endSum / n);
+    printf("Line reaction latency: avg %.2f ms, max %.2f ms over %lld contacts\n",
+           summary->reactions ? summary->reactionSumMs / summary->reactions : 0.0, summary->reactionMaxMs,
+           summary->reactions);
+
+    printf("%-20s %12s %10s %10s %10s %10s %10s\n", "Task", "Iterations", "Period avg", "p99", "max",
+           "Body avg", "max");
+    for (int t = 0; t < summary->numTasks; t++) {
+        const SimTaskStats &total = summary->tasks[t];
+        if (total.iterations == 0) {
+            printf("%-20s %12s\n", total.name, "no vTaskDelay");
+            continue;
+        }
+        printf("%-20s %12lld %8.2fms %8.0fms %8.2fms %8.2fms %8.2fms\n", total.name, total.iterations,
+               total.periodSumUs / 1000.0 / total.iterations, percentile(total.periodHist, total.iterations, 0.99),
+               total.periodMaxUs / 1000.0, total.bodySumUs / 1000.0 / total.iterations, total.bodyMaxUs / 1000.0);
+    }
+
+    printf("Serial: %lld bytes/match, tasks blocked on the UART %.1f ms/match\n", summary->serialBytes / n,
+           summary->serialBlockedMs / n);
+    printf("Simulated %.1f s in %.2f s wall (%.0fx real time)\n", summary->simulatedS, wallS,
+           wallS > 0 ? summary->simulatedS / wallS : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+    int matches = 20;
+    SimConfig config = { 1, 30.0, false, NULL };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--matches") == 0 && i + 1 < argc) {
+            matches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc) {
+            config.timeLimitS = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            config.trace = true;
+        } else if (strcmp(argv[i], "--serial-out") == 0 && i + 1 < argc) {
+            config.serialPath = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--matches N] [--seed S] [--time-limit seconds] [--trace] [--serial-out file]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (matches < 1 || config.timeLimitS <= 0) {
+        fprintf(stderr, "Invalid match count or time limit\n");
+        return 1;
+    }
+
+    if (config.serialPath) {
+        // Matches append to it
+        FILE *capture = fopen(config.serialPath, "wb");
+        if (!capture) {
+            perror(config.serialPath);
+            return 1;
+        }
+        fclose(capture);
+    }
+
+    static Summary summary;
+    static SimResult result;
+    uint64_t firstSeed = config.seed;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < matches; i++) {
+        config.seed = firstSeed + i;
+        if (!runOne(&config, &result)) {
+            return 1;
+        }
+        addResult(&summary, &result);
+    }
+    double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printReport(&summary, wallS);
+    return 0;
+}
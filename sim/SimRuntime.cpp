@@ -0,0 +1,593 @@
+// Runtime behind the Arduino, FreeRTOS and BMI160 stand-ins.
+//
+// Every FreeRTOS task of the sketch, and the Arduino loop task, runs on its own
+// pthread, but only one of them runs at a time. The scheduler hands the baton to
+// the task with the earliest wake-up time, advances the world to that time and
+// waits until the task blocks again. Virtual time only moves when a task waits
+// (vTaskDelay, delay, pulseIn, an I2C transfer, a full UART FIFO) or has spent
+// enough busy time, so a match is deterministic for its seed and runs as fast as
+// the host allows. Each task behaves as if it had a core of its own. Pin interrupt
+// handlers run on the scheduler's thread between time slices, at the time of the edge.
+#include <pthread.h>
+#include <cstdio>
+#include <cstring>
+
+#include "Sim.h"
+#include "Arduino.h"
+#include "DFRobot_BMI160.h"
+#undef abs
+
+#define SIM_COST_QUANTUM_US 50       // Busy time a task may run ahead of the clock before it yields
+#define SIM_DIGITAL_US 1             // GPIO register access
+#define SIM_ANALOG_US 2              // LEDC duty update
+#define SIM_I2C_READ_US 1200         // getAccelGyroData: 12 bytes at 100 kHz plus addressing
+#define SIM_LOOP_IDLE_US 1000        // Charged for a pass of loop() that never waits, one tick
+#define SIM_UART_FIFO 128            // Bytes the UART takes before print() has to wait
+
+struct SimTask {
+    pthread_t thread;
+    pthread_cond_t cond;
+    bool running;
+    bool finished;
+    uint64_t wakeAt;                 // SIM_NEVER while waiting for a mutex without a timeout
+    uint64_t debtUs;                 // Busy time not yet added to the clock
+    SimMutex *waitingFor;
+    int priority;
+    int core;
+    TaskFunction_t function;
+    void *parameter;
+    uint64_t lastDelayStart;         // Start of the previous vTaskDelay, SIM_NEVER before the first
+    uint64_t lastDelayEnd;
+    SimTaskStats *stats;
+};
+
+struct SimMutex {
+    SimTask *owner;
+};
+
+struct SimInterrupt {
+    int pin;
+    int mode;
+    void (*handler)(void *);
+    void *arg;
+    uint64_t lastEdgeUs;             // Edges up to here have been delivered
+};
+
+static pthread_mutex_t simLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t schedulerCond = PTHREAD_COND_INITIALIZER;
+static SimTask simTasks[SIM_MAX_TASKS];
+static int simNumTasks;
+static SimTask *simCurrent;          // Task holding the baton, NULL while the scheduler runs
+static uint64_t simClockUs;
+static SimResult *simResult;
+static const SimConfig *simConfig;
+static SimInterrupt simInterrupts[SIM_MAX_INTERRUPTS];
+static int simNumInterrupts;
+
+// UART state: when the bytes already queued will have left the wire
+static double uartFreeAt;
+static double uartByteUs = 10e6 / 115200;
+static bool uartLineStart = true;
+static FILE *serialCapture;
+
+HardwareSerial Serial;
+
+// Function Prototypes
+static void yieldUntil(uint64_t wakeAt);
+static void* taskEntry(void *arg);
+static void loopTask(void *parameter);
+static void delayTask(uint64_t wakeAt);
+static SimInterrupt* nextInterrupt(uint64_t limitUs, uint64_t *edgeUs);
+static void callPlainHandler(void *arg);
+static size_t serialWrite(const char *data, size_t length, bool text);
+static size_t formatInteger(char *out, unsigned long long magnitude, bool negative, int base);
+
+uint64_t simNow() {
+    return simClockUs + (simCurrent ? simCurrent->debtUs : 0);
+}
+
+static void yieldUntil(uint64_t wakeAt) {
+    // Hand the baton back and sleep until the scheduler picks this task again
+    SimTask *self = simCurrent;
+    self->debtUs = 0;
+    pthread_mutex_lock(&simLock);
+    self->wakeAt = wakeAt;
+    self->running = false;
+    simCurrent = NULL;
+    pthread_cond_signal(&schedulerCond);
+    while (!self->running) {
+        pthread_cond_wait(&self->cond, &simLock);
+    }
+    pthread_mutex_unlock(&simLock);
+}
+
+void simSpend(uint64_t us) {
+    if (!simCurrent) {
+        return;
+    }
+    // Small costs pile up and are paid in one go, so register accesses don't each cost a context switch
+    simCurrent->debtUs += us;
+    if (simCurrent->debtUs >= SIM_COST_QUANTUM_US) {
+        yieldUntil(simClockUs + simCurrent->debtUs);
+    }
+}
+
+void simBlock(uint64_t us) {
+    if (simCurrent) {
+        yieldUntil(simNow() + us);
+    }
+}
+
+static void* taskEntry(void *arg) {
+    SimTask *task = (SimTask*)arg;
+    pthread_mutex_lock(&simLock);
+    while (!task->running) {
+        pthread_cond_wait(&task->cond, &simLock);
+    }
+    pthread_mutex_unlock(&simLock);
+
+    task->function(task->parameter);
+
+    // A FreeRTOS task must never return; if one does, it simply stops being scheduled
+    pthread_mutex_lock(&simLock);
+    task->finished = true;
+    task->running = false;
+    simCurrent = NULL;
+    pthread_cond_signal(&schedulerCond);
+    pthread_mutex_unlock(&simLock);
+    return NULL;
+}
+
+static void loopTask(void *parameter) {
+    (void)parameter;
+    // The ESP32 core runs setup() and then loop() forever in its own task
+    setup();
+    for (;;) {
+        uint64_t before = simNow();
+        loop();
+        if (simNow() == before) {
+            simBlock(SIM_LOOP_IDLE_US);
+        }
+    }
+}
+
+static SimInterrupt* nextInterrupt(uint64_t limitUs, uint64_t *edgeUs) {
+    // Earliest undelivered edge at or before limitUs
+    SimInterrupt *next = NULL;
+    for (int i = 0; i < simNumInterrupts; i++) {
+        SimInterrupt *irq = &simInterrupts[i];
+        uint64_t at;
+        if (irq->handler && worldNextEdge(irq->pin, irq->lastEdgeUs, &at) && at <= limitUs && (!next || at < *edgeUs)) {
+            next = irq;
+            *edgeUs = at;
+        }
+    }
+    return next;
+}
+
+void simRunMatch(const SimConfig *config, SimResult *result) {
+    memset(result, 0, sizeof(SimResult));
+    simResult = result;
+    simConfig = config;
+    simClockUs = 0;
+    simNumTasks = 0;
+    simNumInterrupts = 0;
+    simCurrent = NULL;
+    worldInit(&simWiring, config->seed);
+    serialCapture = NULL;
+    if (config->serialPath) {
+        serialCapture = fopen(config->serialPath, "ab");
+        if (!serialCapture) perror(config->serialPath);
+    }
+    xTaskCreatePinnedToCore(loopTask, "loopTask", 8192, NULL, 1, NULL, 1);
+
+    for (;;) {
+        // Earliest wake-up first; on a tie the higher priority, then the older task
+        SimTask *next = NULL;
+        for (int i = 0; i < simNumTasks; i++) {
+            SimTask *task = &simTasks[i];
+            if (task->finished || task->wakeAt == SIM_NEVER) {
+                continue;
+            }
+            if (!next || task->wakeAt < next->wakeAt ||
+                (task->wakeAt == next->wakeAt && task->priority > next->priority)) {
+                next = task;
+            }
+        }
+        if (!next) {
+            break; // Every task is finished or waits forever
+        }
+
+        // Pin edges due before the task wakes are handled first, at their own time
+        uint64_t edgeAt = 0;
+        SimInterrupt *irq = nextInterrupt(next->wakeAt, &edgeAt);
+        uint64_t until = irq ? edgeAt : next->wakeAt;
+        if (until > simClockUs) {
+            simClockUs = until;
+        }
+        worldAdvance(simClockUs);
+        if (worldDone(simClockUs, config->timeLimitS)) {
+            break;
+        }
+        if (irq) {
+            irq->lastEdgeUs = edgeAt;
+            int level = worldDigitalRead(irq->pin, simClockUs);
+            if (irq->mode == CHANGE || (irq->mode == RISING && level) || (irq->mode == FALLING && !level)) {
+                irq->handler(irq->arg);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&simLock);
+        simCurrent = next;
+        next->running = true;
+        pthread_cond_signal(&next->cond);
+        while (simCurrent) {
+            pthread_cond_wait(&schedulerCond, &simLock);
+        }
+        pthread_mutex_unlock(&simLock);
+    }
+
+    // The task threads stay parked; the match runs in a child process that exits next
+    result->numTasks = simNumTasks;
+    result->simulatedS = simClockUs / 1e6;
+    worldReport(result, simClockUs);
+    if (serialCapture) {
+        fclose(serialCapture);
+    }
+}
+
+// ================= FreeRTOS =================
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    (void)stackDepth;
+    if (simNumTasks == SIM_MAX_TASKS) {
+        return pdFALSE;
+    }
+    SimTask *task = &simTasks[simNumTasks];
+    memset(task, 0, sizeof(SimTask));
+    task->function = function;
+    task->parameter = parameter;
+    task->priority = (int)priority;
+    task->core = core;
+    task->wakeAt = simNow();
+    task->lastDelayStart = SIM_NEVER;
+    task->stats = &simResult->tasks[simNumTasks];
+    snprintf(task->stats->name, SIM_TASK_NAME, "%s", name);
+    pthread_cond_init(&task->cond, NULL);
+    if (pthread_create(&task->thread, NULL, taskEntry, task) != 0) {
+        return pdFALSE;
+    }
+    simNumTasks++;
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+static void delayTask(uint64_t wakeAt) {
+    // Each call closes one pass of the task's loop
+    SimTask *self = simCurrent;
+    SimTaskStats *stats = self->stats;
+    uint64_t now = simNow();
+    if (self->lastDelayStart != SIM_NEVER) {
+        uint64_t period = now - self->lastDelayStart;
+        uint64_t body = now - self->lastDelayEnd;
+        stats->iterations++;
+        stats->periodSumUs += period;
+        stats->bodySumUs += body;
+        if (period > stats->periodMaxUs) stats->periodMaxUs = period;
+        if (body > stats->bodyMaxUs) stats->bodyMaxUs = body;
+        uint64_t bucket = period / 1000;
+        stats->periodHist[bucket < SIM_PERIOD_BUCKETS ? bucket : SIM_PERIOD_BUCKETS - 1]++;
+    }
+    self->lastDelayStart = now;
+    yieldUntil(wakeAt > now ? wakeAt : now);
+    self->lastDelayEnd = simNow();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delayTask(simNow() + (uint64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t increment) {
+    // A task that overran its period doesn't wait; it still keeps its schedule
+    *previousWake += increment;
+    delayTask((uint64_t)*previousWake * portTICK_PERIOD_MS * 1000);
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(simNow() / (portTICK_PERIOD_MS * 1000));
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return (SemaphoreHandle_t)calloc(1, sizeof(SimMutex));
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks) {
+    SimTask *self = simCurrent;
+    if (!mutex->owner) {
+        mutex->owner = self;
+        return pdTRUE;
+    }
+    if (ticks == 0) {
+        return pdFALSE;
+    }
+
+    // Sleep until the owner hands the mutex over, or until the timeout
+    self->waitingFor = mutex;
+    yieldUntil(ticks == portMAX_DELAY ? SIM_NEVER : simNow() + (uint64_t)ticks * portTICK_PERIOD_MS * 1000);
+    self->waitingFor = NULL;
+    return mutex->owner == self ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    if (mutex->owner != simCurrent) {
+        return pdFALSE;
+    }
+    // Pass ownership straight to the highest-priority waiter, as FreeRTOS does
+    SimTask *next = NULL;
+    for (int i = 0; i < simNumTasks; i++) {
+        SimTask *task = &simTasks[i];
+        if (task->waitingFor == mutex && (!next || task->priority > next->priority)) {
+            next = task;
+        }
+    }
+    mutex->owner = next;
+    if (next) {
+        next->waitingFor = NULL;
+        next->wakeAt = simNow();
+    }
+    return pdTRUE;
+}
+
+BaseType_t xPortGetCoreID() {
+    return simCurrent ? simCurrent->core : 0;
+}
+
+// ================= Arduino =================
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+    simSpend(SIM_DIGITAL_US);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    simSpend(SIM_DIGITAL_US);
+    worldDigitalWrite(pin, val, simNow());
+}
+
+int digitalRead(uint8_t pin) {
+    simSpend(SIM_DIGITAL_US);
+    return worldDigitalRead(pin, simNow());
+}
+
+void analogWrite(uint8_t pin, int value) {
+    simSpend(SIM_ANALOG_US);
+    worldAnalogWrite(pin, value, simNow());
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout) {
+    // Busy-waits for the next pulse to start and end; a pulse already under way does not count
+    uint64_t start = simNow();
+    uint64_t rise, fall;
+    if (state == HIGH && worldEchoWindow(pin, &rise, &fall) && rise >= start && fall - start <= timeout) {
+        simBlock(fall - start);
+        return (unsigned long)(fall - rise);
+    }
+    simBlock(timeout);
+    return 0;
+}
+
+static void callPlainHandler(void *arg) {
+    ((void (*)())arg)();
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+    attachInterruptArg(pin, callPlainHandler, (void*)handler, mode);
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode) {
+    simSpend(SIM_DIGITAL_US);
+    SimInterrupt *irq = NULL;
+    for (int i = 0; i < simNumInterrupts && !irq; i++) {
+        if (simInterrupts[i].pin == pin) irq = &simInterrupts[i];
+    }
+    if (!irq) {
+        if (simNumInterrupts == SIM_MAX_INTERRUPTS) {
+            return;
+        }
+        irq = &simInterrupts[simNumInterrupts++];
+    }
+    irq->pin = pin;
+    irq->mode = mode;
+    irq->handler = handler;
+    irq->arg = arg;
+    irq->lastEdgeUs = simNow();
+}
+
+void detachInterrupt(uint8_t pin) {
+    for (int i = 0; i < simNumInterrupts; i++) {
+        if (simInterrupts[i].pin == pin) simInterrupts[i].handler = NULL;
+    }
+}
+
+void delay(uint32_t ms) {
+    simBlock((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    simSpend(us);
+}
+
+unsigned long millis() {
+    return (unsigned long)(simNow() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)simNow();
+}
+
+static size_t serialWrite(const char *data, size_t length, bool text) {
+    if (!simCurrent) {
+        return length;
+    }
+
+    // print() returns once the bytes fit in the FIFO; anything beyond that waits for the wire
+    double now = (double)simNow();
+    double queued = uartFreeAt > now ? (uartFreeAt - now) / uartByteUs : 0.0;
+    if (queued + length > SIM_UART_FIFO) {
+        uint64_t wait = (uint64_t)((queued + length - SIM_UART_FIFO) * uartByteUs);
+        simBlock(wait);
+        simResult->serialBlockedMs += wait / 1000.0;
+        now = (double)simNow();
+    }
+    uartFreeAt = (uartFreeAt > now ? uartFreeAt : now) + length * uartByteUs;
+    simResult->serialBytes += (long long)length;
+
+    if (serialCapture) {
+        fwrite(data, 1, length, serialCapture);
+    }
+    if (simConfig->trace) {
+        if (!text) {
+            // Binary output would garble the trace; note its size instead
+            printf("%s[%11.6f] <%zu bytes>\n", uartLineStart ? "" : "\n", simNow() / 1e6, length);
+            uartLineStart = true;
+            return length;
+        }
+        for (size_t i = 0; i < length; i++) {
+            if (data[i] == '\r') {
+                continue;
+            }
+            if (uartLineStart) {
+                printf("[%11.6f] ", simNow() / 1e6);
+            }
+            putchar(data[i]);
+            uartLineStart = data[i] == '\n';
+        }
+    }
+    return length;
+}
+
+static size_t formatInteger(char *out, unsigned long long magnitude, bool negative, int base) {
+    // Digits without leading zeros, as Arduino's Print does
+    char digits[72];
+    int n = 0;
+    do {
+        int digit = (int)(magnitude % (unsigned)base);
+        digits[n++] = (char)(digit < 10 ? '0' + digit : 'A' + digit - 10);
+        magnitude /= (unsigned)base;
+    } while (magnitude > 0);
+    size_t length = 0;
+    if (negative) {
+        out[length++] = '-';
+    }
+    while (n > 0) {
+        out[length++] = digits[--n];
+    }
+    out[length] = '\0';
+    return length;
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+    uartByteUs = 10e6 / (double)baud; // Start bit, 8 data bits, stop bit
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+    return serialWrite((const char*)&b, 1, false);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+    return serialWrite((const char*)buffer, size, false);
+}
+
+size_t HardwareSerial::print(const char *text) {
+    return serialWrite(text, strlen(text), true);
+}
+
+size_t HardwareSerial::print(char c) {
+    return serialWrite(&c, 1, true);
+}
+
+size_t HardwareSerial::print(int value, int base) {
+    return print((long)value, base);
+}
+
+size_t HardwareSerial::print(unsigned int value, int base) {
+    return print((unsigned long)value, base);
+}
+
+size_t HardwareSerial::print(long value, int base) {
+    // Like Arduino, only decimal output carries a sign
+    char text[72];
+    size_t length = (base == DEC)
+        ? formatInteger(text, value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value, value < 0, DEC)
+        : formatInteger(text, (unsigned long)value, false, base);
+    return serialWrite(text, length, true);
+}
+
+size_t HardwareSerial::print(unsigned long value, int base) {
+    char text[72];
+    size_t length = formatInteger(text, value, false, base);
+    return serialWrite(text, length, true);
+}
+
+size_t HardwareSerial::print(double value, int digits) {
+    char text[64];
+    int length = snprintf(text, sizeof(text), "%.*f", digits, value);
+    return serialWrite(text, (size_t)length, true);
+}
+
+size_t HardwareSerial::println() {
+    return serialWrite("\r\n", 2, true);
+}
+
+size_t HardwareSerial::println(const char *text) {
+    return print(text) + println();
+}
+
+size_t HardwareSerial::println(char c) {
+    return print(c) + println();
+}
+
+size_t HardwareSerial::println(int value, int base) {
+    return print(value, base) + println();
+}
+
+size_t HardwareSerial::println(unsigned int value, int base) {
+    return print(value, base) + println();
+}
+
+size_t HardwareSerial::println(long value, int base) {
+    return print(value, base) + println();
+}
+
+size_t HardwareSerial::println(unsigned long value, int base) {
+    return print(value, base) + println();
+}
+
+size_t HardwareSerial::println(double value, int digits) {
+    return print(value, digits) + println();
+}
+
+// ================= BMI160 =================
+
+int8_t DFRobot_BMI160::softReset() {
+    simBlock(SIM_I2C_READ_US);
+    return BMI160_OK;
+}
+
+int8_t DFRobot_BMI160::I2cInit(int8_t i2c_addr) {
+    (void)i2c_addr;
+    simBlock(SIM_I2C_READ_US);
+    return BMI160_OK;
+}
+
+int8_t DFRobot_BMI160::getAccelGyroData(int16_t *data) {
+    // The registers are read at the end of the transfer
+    simBlock(SIM_I2C_READ_US);
+    worldImu(data);
+    return BMI160_OK;
+}
@@ -0,0 +1,429 @@
+// Arena, robot and sensor model behind the simulated pins.
+//
+// The robot is a differential drive: each wheel follows its commanded speed
+// through a first-order lag, and the body integrates the two wheel speeds in
+// 1 ms steps. The ring arena adds a passive opponent that is pushed by
+// resolving overlaps; the lane arena slows the robot by the load it tows.
+// IR sensors see the white lines under their mounting points, the ultrasonic
+// sensors echo off the opponent, and the IMU reports the body's yaw rate and
+// accelerations with a bias and noise.
+#include <cmath>
+#include <random>
+
+#include "Sim.h"
+
+// Robot, metres and seconds
+#define ROBOT_RADIUS 0.07
+#define WHEEL_BASE 0.14
+#define MAX_WHEEL_SPEED 0.6          // At full duty
+#define MOTOR_DEADBAND 0.15          // Duty below which the wheels don't turn
+#define MOTOR_TAU 0.06               // Wheel speed time constant
+#define IR_X 0.06                    // IR sensors sit at (+-IR_X, +-IR_Y) in the body frame, x forward, y left
+#define IR_Y 0.05
+#define SONAR_X 0.07                 // Ultrasonic sensors at the front, center straight ahead
+#define SONAR_SIDE_ANGLE 30.0        // Degrees the left and right sensors are turned outward
+#define STEP_US 1000
+
+// Ring arena (mini-sumo)
+#define RING_RADIUS 0.385
+#define LINE_WIDTH 0.025
+#define OPPONENT_RADIUS 0.07
+#define OPPONENT_MASS_RATIO 1.0      // Opponent mass over robot mass
+
+// Lane arena
+#define LANE_LENGTH 2.0
+#define LANE_HALF_WIDTH 0.25
+#define LANE_LOAD 0.7                // Share of top speed left when towing the load
+#define STALL_S 1.5                  // Motors off this long after the start counts as a stall
+
+// HC-SR04
+#define SONAR_RANGE 4.0
+#define SONAR_BEAM 15.0              // Half-angle, degrees
+#define SONAR_BURST_US 450           // Trigger to echo rising edge
+#define SONAR_NO_ECHO_US 38000       // Echo pulse when nothing is in range
+#define SOUND_SPEED 343.0
+
+// BMI160, as the sketches read it
+#define GYRO_LSB_PER_DPS 16.4
+#define GYRO_BIAS -11.85             // The offset the sketches add back
+#define GYRO_BIAS_SPREAD 4.0         // Each match's sensor is off from that by up to this much
+#define GYRO_NOISE 3.0
+#define ACCEL_LSB_PER_G 16384.0
+#define ACCEL_NOISE 0.01             // g
+#define GRAVITY 9.81
+
+// Match
+#define BUTTON_DOWN_US 100000        // The start button is held from 0.1 s to 0.6 s
+#define BUTTON_UP_US 600000
+#define START_LIMIT_S 30.0           // A robot that never drives ends the match here
+#define NUM_PINS 64
+
+struct Body {
+    double x, y, heading;
+};
+
+struct World {
+    const SimWiring *wiring;
+    std::mt19937_64 rng;
+    uint64_t physicsUs;
+    Body robot;
+    Body opponent;
+    double vLeft, vRight;
+    double speed;
+    double accelForward;             // m/s^2, body frame
+    double yawRate;                  // rad/s, counter-clockwise positive
+    double gyroBias;                 // Raw counts
+    int pinLevel[NUM_PINS];
+    int pinDuty[NUM_PINS];
+    uint64_t trigHighAt[3];
+    uint64_t echoRise[3];
+    uint64_t echoFall[3];
+    bool echoArmed[3];
+    double commandLeft, commandRight; // Signed duty, -1 to 1
+    uint64_t startUs;
+    uint64_t endUs;
+    int outcome;                     // -1 while the match runs
+    uint64_t firstLineUs;
+    bool lineSeen;                   // Some IR sensor was over a line at the last step
+    uint64_t lineAt;                 // Line contact waiting for the controller to react
+    uint64_t stoppedSince;
+    long long reactions;
+    double reactionSumMs;
+    double reactionMaxMs;
+};
+static World world;
+
+// Function Prototypes
+static bool onLine(double x, double y);
+static void irPosition(int sensor, double *x, double *y);
+static double sonarDistance(int sensor);
+static void updateCommand(uint64_t nowUs);
+static void step(uint64_t nowUs);
+static void finish(int outcome, uint64_t nowUs);
+static double noise(double sigma);
+static int16_t clampRaw(double value);
+
+static double noise(double sigma) {
+    std::normal_distribution<double> dist(0.0, sigma);
+    return dist(world.rng);
+}
+
+static int16_t clampRaw(double value) {
+    return (int16_t)(value > 32767 ? 32767 : (value < -32768 ? -32768 : std::lround(value)));
+}
+
+void worldInit(const SimWiring *wiring, uint64_t seed) {
+    world = World();
+    world.wiring = wiring;
+    world.rng.seed(seed);
+    world.startUs = SIM_NEVER;
+    world.lineAt = SIM_NEVER;
+    world.stoppedSince = SIM_NEVER;
+    world.outcome = -1;
+    world.firstLineUs = SIM_NEVER;
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    world.gyroBias = GYRO_BIAS + (unit(world.rng) * 2 - 1) * GYRO_BIAS_SPREAD;
+
+    if (wiring->arena == ARENA_RING) {
+        // Robot left of center facing anywhere, opponent somewhere it has to be found
+        world.robot = { -0.15, 0.0, unit(world.rng) * 2 * M_PI };
+        do {
+            double r = 0.25 * std::sqrt(unit(world.rng));
+            double a = unit(world.rng) * 2 * M_PI;
+            world.opponent = { r * std::cos(a), r * std::sin(a), 0.0 };
+        } while (std::hypot(world.opponent.x - world.robot.x, world.opponent.y - world.robot.y) < 0.2);
+    } else {
+        // Near the start of the lane, slightly off center and off heading
+        world.robot = { 0.15, (unit(world.rng) - 0.5) * 0.1, (unit(world.rng) - 0.5) * 12.0 * M_PI / 180.0 };
+    }
+}
+
+static bool onLine(double x, double y) {
+    if (world.wiring->arena == ARENA_RING) {
+        double r = std::hypot(x, y);
+        return r > RING_RADIUS - LINE_WIDTH && r <= RING_RADIUS;
+    }
+    // Beyond the lane there is only floor, which reads like the lane itself
+    bool inLane = x >= 0 && x <= LANE_LENGTH && std::fabs(y) <= LANE_HALF_WIDTH;
+    return inLane && (x >= LANE_LENGTH - LINE_WIDTH || std::fabs(y) >= LANE_HALF_WIDTH - LINE_WIDTH);
+}
+
+static void irPosition(int sensor, double *x, double *y) {
+    // Front-left, front-right, back-left, back-right
+    double bx = (sensor < 2) ? IR_X : -IR_X;
+    double by = (sensor % 2 == 0) ? IR_Y : -IR_Y;
+    double c = std::cos(world.robot.heading), s = std::sin(world.robot.heading);
+    *x = world.robot.x + c * bx - s * by;
+    *y = world.robot.y + s * bx + c * by;
+}
+
+static double sonarDistance(int sensor) {
+    // Only the opponent reflects; the ring is open all around
+    if (world.wiring->arena != ARENA_RING) {
+        return -1.0;
+    }
+    static const double mounts[3] = { 0.0, SONAR_SIDE_ANGLE, -SONAR_SIDE_ANGLE };
+    double c = std::cos(world.robot.heading), s = std::sin(world.robot.heading);
+    double sx = world.robot.x + c * SONAR_X, sy = world.robot.y + s * SONAR_X;
+    double dx = world.opponent.x - sx, dy = world.opponent.y - sy;
+    double centerDistance = std::hypot(dx, dy);
+    double surface = centerDistance - OPPONENT_RADIUS;
+    if (surface > SONAR_RANGE) {
+        return -1.0;
+    }
+    if (surface < 0.02) {
+        return 0.02; // Pressed against the opponent, the sensor reads its minimum
+    }
+    double bearing = std::atan2(dy, dx) - (world.robot.heading + mounts[sensor] * M_PI / 180.0);
+    bearing = std::remainder(bearing, 2 * M_PI);
+    double halfWidth = std::asin(OPPONENT_RADIUS / centerDistance);
+    return std::fabs(bearing) <= SONAR_BEAM * M_PI / 180.0 + halfWidth ? surface : -1.0;
+}
+
+static void finish(int outcome, uint64_t nowUs) {
+    if (world.outcome < 0) {
+        world.outcome = outcome;
+        world.endUs = nowUs;
+    }
+}
+
+static void updateCommand(uint64_t nowUs) {
+    const SimWiring *w = world.wiring;
+    bool enabled = world.pinLevel[w->standby] != 0;
+    int leftDir = (world.pinLevel[w->leftIn1] && !world.pinLevel[w->leftIn2]) -
+                  (!world.pinLevel[w->leftIn1] && world.pinLevel[w->leftIn2]);
+    int rightDir = (world.pinLevel[w->rightIn1] && !world.pinLevel[w->rightIn2]) -
+                   (!world.pinLevel[w->rightIn1] && world.pinLevel[w->rightIn2]);
+    double left = enabled ? leftDir * world.pinDuty[w->pwmLeft] / 255.0 : 0.0;
+    double right = enabled ? rightDir * world.pinDuty[w->pwmRight] / 255.0 : 0.0;
+    if (left == world.commandLeft && right == world.commandRight) {
+        return;
+    }
+    world.commandLeft = left;
+    world.commandRight = right;
+
+    // The first drive command marks the end of the countdown
+    if (world.startUs == SIM_NEVER && (left != 0.0 || right != 0.0)) {
+        world.startUs = nowUs;
+    }
+    // A changed command after a line contact is the controller's reaction to it
+    if (world.lineAt != SIM_NEVER) {
+        double ms = (nowUs - world.lineAt) / 1000.0;
+        world.reactions++;
+        world.reactionSumMs += ms;
+        if (ms > world.reactionMaxMs) world.reactionMaxMs = ms;
+        world.lineAt = SIM_NEVER;
+    }
+}
+
+static void step(uint64_t nowUs) {
+    const double dt = STEP_US / 1e6;
+    double maxSpeed = MAX_WHEEL_SPEED * (world.wiring->arena == ARENA_LANE ? LANE_LOAD : 1.0);
+
+    // Wheels chase their commanded speed; small duties don't overcome friction
+    double commands[2] = { world.commandLeft, world.commandRight };
+    double *speeds[2] = { &world.vLeft, &world.vRight };
+    for (int i = 0; i < 2; i++) {
+        double duty = std::fabs(commands[i]);
+        double target = duty <= MOTOR_DEADBAND ? 0.0
+            : std::copysign((duty - MOTOR_DEADBAND) / (1.0 - MOTOR_DEADBAND) * maxSpeed, commands[i]);
+        *speeds[i] += (target - *speeds[i]) * dt / MOTOR_TAU;
+    }
+
+    double speed = (world.vLeft + world.vRight) / 2;
+    world.yawRate = (world.vRight - world.vLeft) / WHEEL_BASE;
+    world.accelForward = (speed - world.speed) / dt;
+    world.speed = speed;
+    world.robot.heading += world.yawRate * dt;
+    world.robot.x += speed * std::cos(world.robot.heading) * dt;
+    world.robot.y += speed * std::sin(world.robot.heading) * dt;
+
+    if (world.wiring->arena == ARENA_RING) {
+        // Contact: push the two bodies apart, the lighter one further
+        double dx = world.opponent.x - world.robot.x, dy = world.opponent.y - world.robot.y;
+        double distance = std::hypot(dx, dy);
+        double overlap = ROBOT_RADIUS + OPPONENT_RADIUS - distance;
+        if (overlap > 0 && distance > 0) {
+            double nx = dx / distance, ny = dy / distance;
+            double opponentShare = 1.0 / (1.0 + OPPONENT_MASS_RATIO);
+            world.opponent.x += nx * overlap * opponentShare;
+            world.opponent.y += ny * overlap * opponentShare;
+            world.robot.x -= nx * overlap * (1.0 - opponentShare);
+            world.robot.y -= ny * overlap * (1.0 - opponentShare);
+        }
+    }
+
+    // Line contacts, for time-to-boundary and the reaction latency
+    bool line = false;
+    for (int i = 0; i < 4; i++) {
+        double x, y;
+        irPosition(i, &x, &y);
+        line |= onLine(x, y);
+    }
+    if (world.startUs != SIM_NEVER) {
+        if (line && !world.lineSeen && world.lineAt == SIM_NEVER) {
+            world.lineAt = nowUs;
+        }
+        if (line && world.firstLineUs == SIM_NEVER) {
+            world.firstLineUs = nowUs;
+        }
+    }
+    world.lineSeen = line;
+
+    // Outcomes
+    if (world.wiring->arena == ARENA_RING) {
+        if (std::hypot(world.opponent.x, world.opponent.y) > RING_RADIUS) {
+            finish(OUTCOME_WIN, nowUs);
+        } else if (std::hypot(world.robot.x, world.robot.y) > RING_RADIUS) {
+            finish(OUTCOME_LOSS, nowUs);
+        }
+    } else {
+        double fx, fy, gx, gy;
+        irPosition(0, &fx, &fy);
+        irPosition(1, &gx, &gy);
+        if (std::fabs(world.robot.y) > LANE_HALF_WIDTH || world.robot.x < 0) {
+            finish(OUTCOME_OUT, nowUs);
+        } else if (fx >= LANE_LENGTH - LINE_WIDTH || gx >= LANE_LENGTH - LINE_WIDTH) {
+            finish(OUTCOME_ARRIVED, nowUs);
+        } else if (world.startUs != SIM_NEVER) {
+            bool stopped = world.commandLeft == 0.0 && world.commandRight == 0.0;
+            if (!stopped) {
+                world.stoppedSince = SIM_NEVER;
+            } else if (world.stoppedSince == SIM_NEVER) {
+                world.stoppedSince = nowUs;
+            } else if (nowUs - world.stoppedSince > (uint64_t)(STALL_S * 1e6)) {
+                finish(OUTCOME_STALLED, nowUs);
+            }
+        }
+    }
+}
+
+void worldAdvance(uint64_t nowUs) {
+    while (world.physicsUs + STEP_US <= nowUs) {
+        world.physicsUs += STEP_US;
+        step(world.physicsUs);
+    }
+}
+
+bool worldDone(uint64_t nowUs, double timeLimitS) {
+    if (world.outcome >= 0) {
+        return true;
+    }
+    if ((world.startUs == SIM_NEVER && nowUs > (uint64_t)(START_LIMIT_S * 1e6)) ||
+        (world.startUs != SIM_NEVER && nowUs - world.startUs > (uint64_t)(timeLimitS * 1e6))) {
+        finish(OUTCOME_TIMEOUT, nowUs);
+        return true;
+    }
+    return false;
+}
+
+void worldDigitalWrite(int pin, int level, uint64_t nowUs) {
+    if (pin < 0 || pin >= NUM_PINS) {
+        return;
+    }
+    int previous = world.pinLevel[pin];
+    world.pinLevel[pin] = level ? 1 : 0;
+
+    const SimWiring *w = world.wiring;
+    for (int i = 0; i < 3; i++) {
+        if (pin != w->trigPins[i]) {
+            continue;
+        }
+        if (level && !previous) {
+            world.trigHighAt[i] = nowUs;
+        } else if (!level && previous && nowUs - world.trigHighAt[i] >= 10 &&
+                   !(world.echoArmed[i] && nowUs < world.echoFall[i])) {
+            // A 10 us trigger pulse starts a measurement unless the last echo is still high
+            double distance = sonarDistance(i);
+            uint64_t width = distance < 0 ? SONAR_NO_ECHO_US : (uint64_t)(distance * 2 / SOUND_SPEED * 1e6);
+            world.echoRise[i] = nowUs + SONAR_BURST_US;
+            world.echoFall[i] = world.echoRise[i] + width;
+            world.echoArmed[i] = true;
+        }
+    }
+    if (pin == w->leftIn1 || pin == w->leftIn2 || pin == w->rightIn1 || pin == w->rightIn2 || pin == w->standby) {
+        updateCommand(nowUs);
+    }
+}
+
+int worldDigitalRead(int pin, uint64_t nowUs) {
+    const SimWiring *w = world.wiring;
+    if (pin == w->button) {
+        return (nowUs >= BUTTON_DOWN_US && nowUs < BUTTON_UP_US) ? 0 : 1; // Pulled up, pressed is low
+    }
+    for (int i = 0; i < 4; i++) {
+        if (pin == w->irPins[i]) {
+            double x, y;
+            irPosition(i, &x, &y);
+            return onLine(x, y) ? w->irLineLevel : !w->irLineLevel;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        if (pin == w->echoPins[i]) {
+            return world.echoArmed[i] && nowUs >= world.echoRise[i] && nowUs < world.echoFall[i];
+        }
+    }
+    return (pin >= 0 && pin < NUM_PINS) ? world.pinLevel[pin] : 0;
+}
+
+void worldAnalogWrite(int pin, int value, uint64_t nowUs) {
+    if (pin < 0 || pin >= NUM_PINS) {
+        return;
+    }
+    world.pinDuty[pin] = value < 0 ? 0 : (value > 255 ? 255 : value);
+    if (pin == world.wiring->pwmLeft || pin == world.wiring->pwmRight) {
+        updateCommand(nowUs);
+    }
+}
+
+bool worldEchoWindow(int pin, uint64_t *riseUs, uint64_t *fallUs) {
+    for (int i = 0; i < 3; i++) {
+        if (pin == world.wiring->echoPins[i] && world.echoArmed[i]) {
+            *riseUs = world.echoRise[i];
+            *fallUs = world.echoFall[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool worldNextEdge(int pin, uint64_t afterUs, uint64_t *edgeUs) {
+    // First echo edge strictly after afterUs; echoes are the only pins that change on their own
+    uint64_t rise, fall;
+    if (!worldEchoWindow(pin, &rise, &fall)) {
+        return false;
+    }
+    if (rise > afterUs) {
+        *edgeUs = rise;
+        return true;
+    }
+    if (fall > afterUs) {
+        *edgeUs = fall;
+        return true;
+    }
+    return false;
+}
+
+void worldImu(int16_t data[6]) {
+    // Gyro z is the yaw axis. The accelerometer is mounted with y pointing backward and
+    // x to the left, with the offsets PullAlgorithm's readAccel subtracts.
+    double lateral = world.speed * world.yawRate;
+    data[0] = clampRaw(noise(GYRO_NOISE));
+    data[1] = clampRaw(noise(GYRO_NOISE));
+    data[2] = clampRaw(world.yawRate * 180.0 / M_PI * GYRO_LSB_PER_DPS + world.gyroBias + noise(GYRO_NOISE));
+    data[3] = clampRaw((lateral / GRAVITY - 0.05 + noise(ACCEL_NOISE)) * ACCEL_LSB_PER_G);
+    data[4] = clampRaw((-world.accelForward / GRAVITY + 0.02 + noise(ACCEL_NOISE)) * ACCEL_LSB_PER_G);
+    data[5] = clampRaw((1.0 + noise(ACCEL_NOISE)) * ACCEL_LSB_PER_G);
+}
+
+void worldReport(SimResult *result, uint64_t nowUs) {
+    uint64_t start = world.startUs == SIM_NEVER ? nowUs : world.startUs;
+    uint64_t end = world.outcome >= 0 ? world.endUs : nowUs;
+    result->outcome = world.outcome >= 0 ? world.outcome : OUTCOME_TIMEOUT;
+    result->startS = start / 1e6;
+    result->endS = (end - start) / 1e6;
+    result->firstLineS = world.firstLineUs == SIM_NEVER ? -1.0 : (world.firstLineUs - start) / 1e6;
+    result->reactions = world.reactions;
+    result->reactionSumMs = world.reactionSumMs;
+    result->reactionMaxMs = world.reactionMaxMs;
+}
@@ -0,0 +1,176 @@
+// Stress test for SnapshotChannel under real threads.
+//
+//   g++ -O2 -std=c++17 -pthread -I. sim/SnapshotStress.cpp -o snapshot_stress
+//   ./snapshot_stress [--seconds S] [--readers N] [--unsafe]
+//
+// One writer publishes as fast as it can; every field of a sample is derived
+// from its sequence number, so a reader can tell a torn copy from a whole
+// one. Readers also check that versions never go backward and match the
+// sample they came with. --unsafe swaps the channel for a plain shared struct
+// to show what the check catches without it. Building with
+// -fsanitize=thread checks the channel itself for data races.
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "SnapshotChannel.h"
+
+#define MAX_READERS 16
+
+// Shaped like the sketches' sensor snapshots, a little over a cache line
+struct Sample {
+    uint32_t seq;
+    uint32_t stampMs;
+    float distances[3];
+    float heading;
+    float velocity;
+    uint8_t boundaryCode;
+    uint8_t flags[3];
+    uint32_t pad[6];
+    uint32_t check;
+};
+
+struct ReaderStats {
+    long long reads;
+    long long fresh;             // Reads that returned a newer version than the last
+    long long torn;
+    long long backward;
+    uint32_t maxGap;             // Largest jump in versions between two fresh reads
+};
+
+static SnapshotChannel<Sample> channel;
+static Sample unsafeShared;
+static std::atomic<uint32_t> unsafeVersion{0};
+static std::atomic<bool> stop{false};
+static bool unsafeMode = false;
+static ReaderStats readerStats[MAX_READERS];
+
+// Function Prototypes
+static void makeSample(uint32_t seq, Sample *s);
+static bool wholeSample(const Sample *s);
+static void* writerThread(void *arg);
+static void* readerThread(void *arg);
+
+static void makeSample(uint32_t seq, Sample *s) {
+    s->seq = seq;
+    s->stampMs = seq * 7u;
+    for (int i = 0; i < 3; i++) {
+        s->distances[i] = (float)(seq % 1000u) + i;
+        s->flags[i] = (uint8_t)(seq + i);
+    }
+    s->heading = (float)(seq % 360u);
+    s->velocity = (float)(seq % 100u) / 100.0f;
+    s->boundaryCode = (uint8_t)(seq & 0xF);
+    for (int i = 0; i < 6; i++) {
+        s->pad[i] = seq ^ (0x9E3779B9u * (uint32_t)(i + 1));
+    }
+    s->check = ~seq;
+}
+
+static bool wholeSample(const Sample *s) {
+    Sample expected;
+    memset(&expected, 0, sizeof(expected));
+    makeSample(s->seq, &expected);
+    return memcmp(s, &expected, sizeof(Sample)) == 0;
+}
+
+static void* writerThread(void *arg) {
+    (void)arg;
+    Sample s;
+    memset(&s, 0, sizeof(s));
+    for (uint32_t seq = 1; !stop.load(std::memory_order_relaxed); seq++) {
+        makeSample(seq, &s);
+        if (unsafeMode) {
+            memcpy(&unsafeShared, &s, sizeof(Sample));
+            unsafeVersion.store(seq, std::memory_order_release);
+        } else {
+            channel.publish(s);
+        }
+    }
+    return NULL;
+}
+
+static void* readerThread(void *arg) {
+    ReaderStats *stats = (ReaderStats*)arg;
+    Sample s;
+    memset(&s, 0, sizeof(s));
+    uint32_t last = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        uint32_t version;
+        if (unsafeMode) {
+            version = unsafeVersion.load(std::memory_order_acquire);
+            memcpy(&s, &unsafeShared, sizeof(Sample));
+        } else {
+            version = channel.read(s);
+        }
+        stats->reads++;
+        if (version == 0) {
+            continue;
+        }
+        if (!wholeSample(&s) || (!unsafeMode && s.seq != version)) {
+            stats->torn++;
+        }
+        if (version < last) {
+            stats->backward++;
+        } else if (version > last) {
+            if (last != 0 && version - last > stats->maxGap) stats->maxGap = version - last;
+            stats->fresh++;
+            last = version;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = 2.0;
+    int readers = 3;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc) {
+            readers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--unsafe") == 0) {
+            unsafeMode = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--seconds S] [--readers N] [--unsafe]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (readers < 1 || readers > MAX_READERS || seconds <= 0) {
+        fprintf(stderr, "Readers must be 1-%d and seconds positive\n", MAX_READERS);
+        return 1;
+    }
+
+    pthread_t writer, readerThreads[MAX_READERS];
+    auto begin = std::chrono::steady_clock::now();
+    pthread_create(&writer, NULL, writerThread, NULL);
+    for (int i = 0; i < readers; i++) {
+        pthread_create(&readerThreads[i], NULL, readerThread, &readerStats[i]);
+    }
+    struct timespec pause = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+    nanosleep(&pause, NULL);
+    stop.store(true);
+    pthread_join(writer, NULL);
+    for (int i = 0; i < readers; i++) {
+        pthread_join(readerThreads[i], NULL);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    Sample last;
+    uint32_t published = unsafeMode ? unsafeVersion.load() : channel.read(last);
+    long long torn = 0, backward = 0;
+    printf("%s: %u samples published in %.2f s (%.1f M/s)\n", unsafeMode ? "Plain struct" : "SnapshotChannel",
+           published, elapsed, published / elapsed / 1e6);
+    for (int i = 0; i < readers; i++) {
+        const ReaderStats &r = readerStats[i];
+        printf("Reader %d: %lld reads, %lld fresh, max version gap %u, %lld torn, %lld backward\n", i, r.reads,
+               r.fresh, r.maxGap, r.torn, r.backward);
+        torn += r.torn;
+        backward += r.backward;
+    }
+    printf("%s\n", torn == 0 && backward == 0 ? "No torn or out-of-order snapshots" : "FAILED");
+    return (torn == 0 && backward == 0) ? 0 : 1;
+}
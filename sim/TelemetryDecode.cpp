@@ -0,0 +1,102 @@
+// Turns a serial capture of the sketches' telemetry frames into CSV.
+//
+//   g++ -O2 -std=c++17 -I. sim/TelemetryDecode.cpp -o telemetry_decode
+//   ./telemetry_decode [capture.bin] > samples.csv
+//
+// The capture can come from the robot's serial port or from the simulator's
+// --serial-out. Bytes that aren't part of a frame with a good checksum, such
+// as the countdown text, are skipped. A sequence number that drops back to
+// zero starts a new session (a reset, or the next simulated match); any other
+// jump counts the samples lost to a full ring. A summary goes to stderr.
+#include <cstdio>
+#include <cstring>
+
+#include "Telemetry.h"
+
+#define BUFFER_BYTES 65536
+
+struct DecodeStats {
+    long long frames;
+    long long skippedBytes;
+    long long missing;           // Samples recorded but never seen, from sequence gaps
+    int sessions;
+    bool haveSeq;
+    uint16_t lastSeq;
+};
+
+// Function Prototypes
+static void printSample(const TelemetrySample *s, DecodeStats *stats);
+static void decode(FILE *in, DecodeStats *stats);
+
+static void printSample(const TelemetrySample *s, DecodeStats *stats) {
+    if (!stats->haveSeq || s->seq == 0) {
+        stats->sessions++;
+    } else {
+        stats->missing += (uint16_t)(s->seq - stats->lastSeq - 1);
+    }
+    stats->haveSeq = true;
+    stats->lastSeq = s->seq;
+
+    printf("%d,%u,%u,%d,0x%X,", stats->sessions, (unsigned)s->seq, (unsigned)s->stampUs, s->state, s->irCode);
+    for (int i = 0; i < 3; i++) {
+        if (s->distanceMm[i] != TELEMETRY_NO_DISTANCE) printf("%.1f", s->distanceMm[i] / 10.0);
+        printf(",");
+    }
+    printf("%.2f,", s->headingCdeg / 100.0);
+    if (s->velocityMmS != TELEMETRY_NO_VELOCITY) printf("%.3f", s->velocityMmS / 1000.0);
+    printf(",%u,%u,%u\n", s->pwmLeft, s->pwmRight, s->flags);
+    stats->frames++;
+}
+
+static void decode(FILE *in, DecodeStats *stats) {
+    static uint8_t buffer[BUFFER_BYTES];
+    size_t have = 0;
+    for (;;) {
+        size_t n = fread(buffer + have, 1, sizeof(buffer) - have, in);
+        have += n;
+        size_t at = 0;
+        while (at + TELEMETRY_FRAME_BYTES <= have) {
+            TelemetrySample sample;
+            if (telemetryDecode(buffer + at, &sample)) {
+                printSample(&sample, stats);
+                at += TELEMETRY_FRAME_BYTES;
+            } else {
+                stats->skippedBytes++;
+                at++;
+            }
+        }
+        memmove(buffer, buffer + at, have - at);
+        have -= at;
+        if (n == 0) {
+            break;
+        }
+    }
+    stats->skippedBytes += (long long)have;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [capture.bin]\n", argv[0]);
+        return 1;
+    }
+    FILE *in = stdin;
+    if (argc == 2) {
+        in = fopen(argv[1], "rb");
+        if (!in) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    DecodeStats stats;
+    memset(&stats, 0, sizeof(stats));
+    printf("session,seq,stamp_us,state,ir_code,center_cm,left_cm,right_cm,heading_deg,velocity_mps,"
+           "pwm_left,pwm_right,flags\n");
+    decode(in, &stats);
+    if (in != stdin) {
+        fclose(in);
+    }
+    fprintf(stderr, "%lld frames in %d sessions, %lld samples missing, %lld bytes skipped\n", stats.frames,
+            stats.sessions, stats.missing, stats.skippedBytes);
+    return 0;
+}